@@ -0,0 +1,30 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QtGlobal>
+
+// Counts the heap allocations of the whole process. With glibc, malloc, calloc and realloc are
+// interposed, which also catches the allocations of Qt containers; elsewhere only operator new is
+// replaced.
+class AllocationCounter
+{
+public:
+    AllocationCounter();
+
+    // allocations since the counter was created
+    quint64 count() const;
+
+    static quint64 totalCount();
+
+private:
+    quint64 m_start;
+};
@@ -0,0 +1,218 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+// Replays toolbar drag sessions and reports the latency of every mouse event, including the layout
+// pass it triggers. Sessions are recorded on a real display with
+//
+//   bench_kdtoolbars_dragreplay --record <file> [toolbar count] [action count]
+//
+// and replayed from the directory given by KDTOOLBARS_DRAG_RECORDINGS, along with a synthetic
+// session that is always available. Both modes use the Fusion style, so that toolbars have the same
+// size when recording and replaying.
+
+#include "benchmarkwindow.h"
+#include "dragrecording.h"
+
+#include <kdtoolbars/mainwindow.h>
+#include <kdtoolbars/toolbar.h>
+
+#include <toolbarlayout.h>
+
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QMouseEvent>
+#include <QStyleFactory>
+#include <QTest>
+#include <QTimer>
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+
+using namespace KDToolBars;
+
+namespace {
+
+constexpr int kDefaultToolBarCount = 12;
+constexpr int kDefaultActionCount = 10;
+constexpr int kReplayCount = 5;
+constexpr int kSyntheticStep = 4; // pixels between synthetic mouse moves
+constexpr int kSyntheticInterval = 8; // msecs between synthetic mouse moves
+
+// Drags the first toolbar along the top tray, out of it and into the left tray
+DragRecording syntheticRecording(MainWindow *mainWindow)
+{
+    DragRecording recording;
+    recording.toolbarCount = kDefaultToolBarCount;
+    recording.actionCount = kDefaultActionCount;
+    recording.windowGeometry = mainWindow->geometry();
+    recording.initialState = mainWindow->saveToolBarState();
+
+    auto *toolbar = mainWindow->toolBarAt(0);
+    const auto handle = static_cast<ToolBarLayout *>(toolbar->layout())->handleArea().center();
+    const auto start = toolbar->mapToGlobal(handle);
+    const auto leftTray = mainWindow->mapToGlobal(QPoint(10, 0));
+    const QPoint path[] = { start, start + QPoint(300, 0), start + QPoint(300, 250), QPoint(leftTray.x(), start.y() + 250) };
+
+    qint64 timestamp = 0;
+    recording.events.push_back({ timestamp, QEvent::MouseButtonPress, toolbar->objectName(), start, Qt::LeftButton, Qt::LeftButton });
+    for (size_t i = 1; i < std::size(path); ++i) {
+        const auto from = path[i - 1];
+        const auto to = path[i];
+        const auto steps = std::max((to - from).manhattanLength() / kSyntheticStep, 1);
+        for (int step = 1; step <= steps; ++step) {
+            timestamp += kSyntheticInterval;
+            const auto pos = from + (to - from) * step / steps;
+            recording.events.push_back({ timestamp, QEvent::MouseMove, toolbar->objectName(), pos, Qt::NoButton, Qt::LeftButton });
+        }
+    }
+    timestamp += kSyntheticInterval;
+    recording.events.push_back({ timestamp, QEvent::MouseButtonRelease, toolbar->objectName(), path[std::size(path) - 1], Qt::LeftButton, Qt::NoButton });
+    return recording;
+}
+
+// latency of every event in nanoseconds
+std::vector<qint64> replay(MainWindow *mainWindow, const DragRecording &recording)
+{
+    std::vector<qint64> latencies;
+    latencies.reserve(recording.events.size());
+    for (const auto &event : recording.events) {
+        auto *toolbar = mainWindow->findChild<ToolBar *>(event.toolbar);
+        if (toolbar == nullptr)
+            continue;
+        QMouseEvent mouseEvent(event.type, QPointF(toolbar->mapFromGlobal(event.globalPos)), QPointF(event.globalPos),
+                               event.button, event.buttons, Qt::NoModifier);
+        mouseEvent.setTimestamp(event.timestamp);
+
+        QElapsedTimer timer;
+        timer.start();
+        QApplication::sendEvent(toolbar, &mouseEvent);
+        QApplication::sendPostedEvents(nullptr, QEvent::LayoutRequest);
+        latencies.push_back(timer.nsecsElapsed());
+    }
+    return latencies;
+}
+
+qint64 percentile(const std::vector<qint64> &sortedValues, int percent)
+{
+    if (sortedValues.empty())
+        return 0;
+    const auto index = (sortedValues.size() - 1) * percent / 100;
+    return sortedValues[index];
+}
+
+} // namespace
+
+class BenchDragReplay : public QObject
+{
+    Q_OBJECT
+private slots:
+    void benchReplay_data();
+    void benchReplay();
+};
+
+void BenchDragReplay::benchReplay_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    QTest::newRow("synthetic") << QString();
+
+    const auto directory = qEnvironmentVariable("KDTOOLBARS_DRAG_RECORDINGS");
+    if (directory.isEmpty())
+        return;
+    const auto fileNames = QDir(directory).entryList({ QStringLiteral("*.kdtbdrag") }, QDir::Files, QDir::Name);
+    for (const auto &fileName : fileNames)
+        QTest::newRow(qPrintable(fileName)) << QDir(directory).filePath(fileName);
+}
+
+void BenchDragReplay::benchReplay()
+{
+    QFETCH(QString, fileName);
+
+    std::optional<DragRecording> recording;
+    if (!fileName.isEmpty()) {
+        recording = DragRecording::load(fileName);
+        QVERIFY2(recording, qPrintable(QStringLiteral("Invalid recording %1").arg(fileName)));
+    }
+
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, recording ? recording->toolbarCount : kDefaultToolBarCount,
+                       recording ? recording->actionCount : kDefaultActionCount);
+    mainWindow.setGeometry(recording ? recording->windowGeometry : kWindowGeometry);
+    mainWindow.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&mainWindow));
+
+    if (!recording)
+        recording = syntheticRecording(&mainWindow);
+
+    std::vector<qint64> latencies;
+    QByteArray finalState = recording->finalState;
+    for (int i = 0; i < kReplayCount; ++i) {
+        QVERIFY(mainWindow.restoreToolBarState(recording->initialState));
+        QApplication::sendPostedEvents(nullptr, QEvent::LayoutRequest);
+
+        const auto replayLatencies = replay(&mainWindow, *recording);
+        latencies.insert(latencies.end(), replayLatencies.begin(), replayLatencies.end());
+
+        // synthetic sessions have no recorded outcome, but every replay must end the same way
+        const auto state = mainWindow.saveToolBarState();
+        if (finalState.isEmpty())
+            finalState = state;
+        QCOMPARE(state, finalState);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    qInfo("%zu events: p50 %lld ns, p90 %lld ns, p99 %lld ns, max %lld ns", latencies.size(), percentile(latencies, 50),
+          percentile(latencies, 90), percentile(latencies, 99), latencies.empty() ? 0 : latencies.back());
+    QTest::setBenchmarkResult(percentile(latencies, 99), QTest::WalltimeNanoseconds);
+}
+
+int main(int argc, char *argv[])
+{
+    const auto arguments = [argc, argv] {
+        QStringList arguments;
+        for (int i = 0; i < argc; ++i)
+            arguments.append(QString::fromLocal8Bit(argv[i]));
+        return arguments;
+    }();
+    const bool isRecording = arguments.size() >= 3 && arguments[1] == QLatin1String("--record");
+
+    if (!isRecording && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    QApplication::setStyle(QStyleFactory::create(QStringLiteral("Fusion")));
+
+    if (!isRecording) {
+        BenchDragReplay benchmark;
+        return QTest::qExec(&benchmark, argc, argv);
+    }
+
+    const auto toolbarCount = arguments.size() > 3 ? arguments[3].toInt() : kDefaultToolBarCount;
+    const auto actionCount = arguments.size() > 4 ? arguments[4].toInt() : kDefaultActionCount;
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, toolbarCount, actionCount);
+    mainWindow.setGeometry(kWindowGeometry);
+    mainWindow.show();
+
+    // the recording starts once the window is laid out, and ends when the window is closed
+    std::unique_ptr<DragRecorder> recorder;
+    QTimer::singleShot(0, &mainWindow, [&] {
+        recorder = std::make_unique<DragRecorder>(&mainWindow, toolbarCount, actionCount);
+    });
+    const auto result = app.exec();
+    if (recorder && !recorder->recording().save(arguments[2])) {
+        qWarning("Could not write %s", qPrintable(arguments[2]));
+        return 1;
+    }
+    return result;
+}
+
+#include "bench_dragreplay.moc"
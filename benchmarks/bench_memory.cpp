@@ -0,0 +1,101 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+// Reports the memory held by the toolbars of a main window for every action they show, as counted
+// by MainWindow::toolBarMemoryUsage, and fails if it goes above the agreed ceiling. The window is
+// laid out with some floating toolbars, and keeps a default state and a perspective, as an
+// application would.
+
+#include "benchmarkmain.h"
+#include "benchmarkwindow.h"
+
+#include <QColor>
+#include <QPixmap>
+
+#include <vector>
+
+using namespace KDToolBars;
+
+namespace {
+
+constexpr int kToolBarCounts[] = { 1, 10, 60 };
+constexpr int kActionCounts[] = { 10, 50, 200 };
+constexpr int kIconCount = 20; // icons are shared by the actions, as they would be in an application
+constexpr int kIconExtent = 24;
+
+// The pixmap of one 24x24 icon is 2304 bytes: the worst case, a small toolbar with an icon for
+// every action, must stay below twice that once the close button, layouts and states are added
+constexpr qint64 kMaxBytesPerAction = 4096;
+
+std::vector<QIcon> createIcons()
+{
+    std::vector<QIcon> icons;
+    for (int i = 0; i < kIconCount; ++i) {
+        QPixmap pixmap(kIconExtent, kIconExtent);
+        pixmap.fill(QColor::fromHsv(i * 360 / kIconCount, 255, 255));
+        icons.emplace_back(pixmap);
+    }
+    return icons;
+}
+
+} // namespace
+
+class BenchMemory : public QObject
+{
+    Q_OBJECT
+private slots:
+    void benchBytesPerAction_data();
+    void benchBytesPerAction();
+};
+
+void BenchMemory::benchBytesPerAction_data()
+{
+    QTest::addColumn<int>("toolbarCount");
+    QTest::addColumn<int>("actionCount");
+
+    for (auto toolbarCount : kToolBarCounts) {
+        for (auto actionCount : kActionCounts)
+            QTest::addRow("%d toolbars/%d actions", toolbarCount, actionCount) << toolbarCount << actionCount;
+    }
+}
+
+void BenchMemory::benchBytesPerAction()
+{
+    QFETCH(int, toolbarCount);
+    QFETCH(int, actionCount);
+
+    BenchmarkToolBars toolbars;
+    toolbars.toolbarCount = toolbarCount;
+    toolbars.actionCount = actionCount;
+    toolbars.icons = createIcons();
+    toolbars.floatingInterval = kFloatingInterval;
+    toolbars.trays = { ToolBarTray::Top, ToolBarTray::Left, ToolBarTray::Right, ToolBarTray::Bottom };
+    toolbars.rowLength = 2;
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, toolbars);
+    mainWindow.setGeometry(kWindowGeometry);
+    mainWindow.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&mainWindow));
+    QApplication::sendPostedEvents(nullptr, QEvent::LayoutRequest);
+    mainWindow.captureDefaultToolBarState();
+    mainWindow.registerToolBarPerspective(QStringLiteral("default"), mainWindow.defaultToolBarState());
+
+    const auto usage = mainWindow.toolBarMemoryUsage();
+    const auto bytesPerAction = usage.totalBytes() / (toolbarCount * actionCount);
+    qInfo("%d widgets, %d connections, %lld pixmap bytes, %d dynamic layouts (%lld bytes), %lld state bytes",
+          usage.childWidgetCount, usage.connectionCount, usage.pixmapBytes, usage.dynamicLayoutCount,
+          usage.dynamicLayoutBytes, usage.stateBytes);
+    QTest::setBenchmarkResult(bytesPerAction, QTest::BytesAllocated);
+    QVERIFY2(bytesPerAction <= kMaxBytesPerAction,
+             qPrintable(QStringLiteral("%1 bytes per action, the ceiling is %2").arg(bytesPerAction).arg(kMaxBytesPerAction)));
+}
+
+KDTOOLBARS_BENCHMARK_MAIN(BenchMemory)
+#include "bench_memory.moc"
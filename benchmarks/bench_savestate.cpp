@@ -0,0 +1,211 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "allocationcounter.h"
+#include "benchmarkmain.h"
+#include "benchmarkwindow.h"
+
+#include <kdtoolbars/toolbar.h>
+#include <kdtoolbars/toolbarstatesnapshot.h>
+
+using namespace KDToolBars;
+
+namespace {
+
+constexpr int kToolBarCounts[] = { 1, 10, 50, 200 };
+constexpr int kActionCounts[] = { 10, 100, 500 };
+constexpr int kCustomInterval = 7; // every seventh toolbar is a custom one
+
+// Toolbars spread over all trays, some of them floating or custom
+void populateMainWindow(MainWindow *mainWindow, int toolbarCount, int actionCount)
+{
+    BenchmarkToolBars toolbars;
+    toolbars.toolbarCount = toolbarCount;
+    toolbars.actionCount = actionCount;
+    toolbars.customInterval = kCustomInterval;
+    toolbars.floatingInterval = kFloatingInterval;
+    toolbars.trays = { ToolBarTray::Top, ToolBarTray::Left, ToolBarTray::Right, ToolBarTray::Bottom };
+    toolbars.rowLength = 2;
+    populateMainWindow(mainWindow, toolbars);
+}
+
+// The same toolbars with their actions in reverse order, all in the top tray, so that restoring
+// one state after the other changes every toolbar
+QByteArray rearrangedState(MainWindow *mainWindow)
+{
+    const auto state = mainWindow->saveToolBarState();
+    const auto count = mainWindow->toolBarCount();
+    QVector<ToolBarPlacement> placements;
+    for (int i = 0; i < count; ++i) {
+        auto *toolbar = mainWindow->toolBarAt(i);
+        const auto actions = toolbar->actions();
+        for (auto it = actions.rbegin(); it != actions.rend(); ++it)
+            toolbar->addAction(*it);
+        placements.append({ toolbar, ToolBarTray::Top, i / 4, 0 });
+    }
+    mainWindow->placeToolBars(placements);
+    const auto rearranged = mainWindow->saveToolBarState();
+    mainWindow->restoreToolBarState(state);
+    return rearranged;
+}
+
+void addRows()
+{
+    QTest::addColumn<int>("toolbarCount");
+    QTest::addColumn<int>("actionCount");
+
+    for (auto toolbarCount : kToolBarCounts) {
+        for (auto actionCount : kActionCounts)
+            QTest::addRow("%d toolbars/%d actions", toolbarCount, actionCount) << toolbarCount << actionCount;
+    }
+}
+
+} // namespace
+
+class BenchSaveState : public QObject
+{
+    Q_OBJECT
+private slots:
+    void benchSaveState_data();
+    void benchSaveState();
+    void benchSaveStateAllocations_data();
+    void benchSaveStateAllocations();
+    void benchDecodeState_data();
+    void benchDecodeState();
+    void benchRestoreState_data();
+    void benchRestoreState();
+    void benchRestoreStateAllocations_data();
+    void benchRestoreStateAllocations();
+    void benchRestoreUnchangedState_data();
+    void benchRestoreUnchangedState();
+};
+
+void BenchSaveState::benchSaveState_data()
+{
+    addRows();
+}
+
+void BenchSaveState::benchSaveState()
+{
+    QFETCH(int, toolbarCount);
+    QFETCH(int, actionCount);
+
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, toolbarCount, actionCount);
+
+    QByteArray state;
+    QBENCHMARK {
+        state = mainWindow.saveToolBarState();
+    }
+    qInfo("%d bytes", int(state.size()));
+}
+
+void BenchSaveState::benchSaveStateAllocations_data()
+{
+    addRows();
+}
+
+void BenchSaveState::benchSaveStateAllocations()
+{
+    QFETCH(int, toolbarCount);
+    QFETCH(int, actionCount);
+
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, toolbarCount, actionCount);
+
+    AllocationCounter counter;
+    const auto state = mainWindow.saveToolBarState();
+    const auto allocations = counter.count();
+    qInfo("%d bytes", int(state.size()));
+    QTest::setBenchmarkResult(allocations, QTest::Events);
+}
+
+void BenchSaveState::benchDecodeState_data()
+{
+    addRows();
+}
+
+void BenchSaveState::benchDecodeState()
+{
+    QFETCH(int, toolbarCount);
+    QFETCH(int, actionCount);
+
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, toolbarCount, actionCount);
+    const auto state = mainWindow.saveToolBarState();
+
+    QBENCHMARK {
+        const auto snapshot = ToolBarStateSnapshot::fromByteArray(state);
+        QVERIFY(snapshot.isValid());
+    }
+}
+
+void BenchSaveState::benchRestoreState_data()
+{
+    addRows();
+}
+
+void BenchSaveState::benchRestoreState()
+{
+    QFETCH(int, toolbarCount);
+    QFETCH(int, actionCount);
+
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, toolbarCount, actionCount);
+    const QByteArray states[] = { mainWindow.saveToolBarState(), rearrangedState(&mainWindow) };
+
+    // every iteration restores the other arrangement, so that every toolbar changes
+    int iteration = 0;
+    QBENCHMARK {
+        QVERIFY(mainWindow.restoreToolBarState(states[++iteration % 2]));
+    }
+}
+
+void BenchSaveState::benchRestoreStateAllocations_data()
+{
+    addRows();
+}
+
+void BenchSaveState::benchRestoreStateAllocations()
+{
+    QFETCH(int, toolbarCount);
+    QFETCH(int, actionCount);
+
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, toolbarCount, actionCount);
+    const auto rearranged = rearrangedState(&mainWindow);
+
+    AllocationCounter counter;
+    QVERIFY(mainWindow.restoreToolBarState(rearranged));
+    QTest::setBenchmarkResult(counter.count(), QTest::Events);
+}
+
+void BenchSaveState::benchRestoreUnchangedState_data()
+{
+    addRows();
+}
+
+void BenchSaveState::benchRestoreUnchangedState()
+{
+    QFETCH(int, toolbarCount);
+    QFETCH(int, actionCount);
+
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, toolbarCount, actionCount);
+    const auto state = mainWindow.saveToolBarState();
+
+    QBENCHMARK {
+        QVERIFY(mainWindow.restoreToolBarState(state));
+    }
+    QCOMPARE(mainWindow.lastRestoreChangeCount(), 0);
+}
+
+KDTOOLBARS_BENCHMARK_MAIN(BenchSaveState)
+#include "bench_savestate.moc"
@@ -0,0 +1,243 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+// Measures the time from creating a main window to its first frame, split into construction
+// (creating the toolbars and restoring their state), first layout and first paint. Every startup
+// uses a new main window, so each phase is only run once per sample and the median of several
+// samples is reported. Icons are the SVG icons of the examples, so the Qt SVG image format plugin
+// must be available for them to be painted.
+
+#include "benchmarkmain.h"
+#include "benchmarkwindow.h"
+
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QLayout>
+
+#include <algorithm>
+#include <memory>
+
+using namespace KDToolBars;
+
+namespace {
+
+constexpr int kToolBarCounts[] = { 1, 10, 50 };
+constexpr int kActionCounts[] = { 10, 50, 200 };
+constexpr int kSampleCount = 10;
+constexpr int kPaintTimeout = 5000; // msecs
+
+const char *const kIconNames[] = {
+    "coffee", "globe", "sun", "moon", "cloud", "cloud-rain", "arrow-left", "arrow-right", "arrow-up", "arrow-down",
+    "upload", "download", "file", "folder", "image", "music", "video", "file-text", "star", "feather",
+};
+
+enum class Phase {
+    Construction,
+    FirstLayout,
+    FirstPaint,
+};
+
+struct StartupTimes
+{
+    qint64 construction = 0; // nsecs
+    qint64 firstLayout = 0;
+    qint64 firstPaint = 0;
+    bool isPainted = false;
+};
+
+class FirstPaintWatcher : public QObject
+{
+public:
+    explicit FirstPaintWatcher(QWidget *widget)
+    {
+        widget->installEventFilter(this);
+    }
+
+    bool isPainted() const
+    {
+        return m_isPainted;
+    }
+
+    bool eventFilter(QObject *watched, QEvent *event) override
+    {
+        if (event->type() == QEvent::Paint)
+            m_isPainted = true;
+        return QObject::eventFilter(watched, event);
+    }
+
+private:
+    bool m_isPainted = false;
+};
+
+// Toolbars in the top tray, with the icons of the examples loaded as the application starts
+BenchmarkToolBars startupToolBars(int toolbarCount, int actionCount)
+{
+    BenchmarkToolBars toolbars;
+    toolbars.toolbarCount = toolbarCount;
+    toolbars.actionCount = actionCount;
+    for (const auto *iconName : kIconNames)
+        toolbars.icons.emplace_back(QLatin1String(":/") + QLatin1String(iconName));
+    return toolbars;
+}
+
+// A state with every toolbar in another tray and every fifth one floating, as a user would have
+// saved it
+QByteArray savedState(int toolbarCount, int actionCount)
+{
+    auto toolbars = startupToolBars(toolbarCount, actionCount);
+    toolbars.floatingInterval = kFloatingInterval;
+    toolbars.trays = { ToolBarTray::Left, ToolBarTray::Bottom, ToolBarTray::Right };
+    toolbars.rowLength = 2;
+
+    MainWindow mainWindow;
+    populateMainWindow(&mainWindow, toolbars);
+    return mainWindow.saveToolBarState();
+}
+
+// Layouts of hidden widgets ignore layout requests, activate them parents first like showing the
+// window would
+void activateLayouts(QWidget *widget)
+{
+    if (auto *layout = widget->layout())
+        layout->activate();
+    const auto children = widget->findChildren<QWidget *>(QString(), Qt::FindDirectChildrenOnly);
+    for (auto *child : children)
+        activateLayouts(child);
+}
+
+StartupTimes startup(int toolbarCount, int actionCount, const QByteArray &state)
+{
+    StartupTimes times;
+    QElapsedTimer timer;
+
+    timer.start();
+    auto mainWindow = std::make_unique<MainWindow>();
+    populateMainWindow(mainWindow.get(), startupToolBars(toolbarCount, actionCount));
+    if (!state.isEmpty())
+        mainWindow->restoreToolBarState(state);
+    times.construction = timer.nsecsElapsed();
+
+    timer.restart();
+    mainWindow->setGeometry(kWindowGeometry);
+    mainWindow->ensurePolished();
+    activateLayouts(mainWindow.get());
+    times.firstLayout = timer.nsecsElapsed();
+
+    // showing the window still resizes the widgets that only get their final size from their parent
+    FirstPaintWatcher watcher(mainWindow.get());
+    const QDeadlineTimer deadline(kPaintTimeout);
+    timer.restart();
+    mainWindow->show();
+    while (!watcher.isPainted() && !deadline.hasExpired())
+        QApplication::processEvents();
+    times.firstPaint = timer.nsecsElapsed();
+    times.isPainted = watcher.isPainted();
+
+    mainWindow.reset();
+    QApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    return times;
+}
+
+void addRows()
+{
+    QTest::addColumn<int>("toolbarCount");
+    QTest::addColumn<int>("actionCount");
+    QTest::addColumn<bool>("restoreState");
+
+    for (auto toolbarCount : kToolBarCounts) {
+        for (auto actionCount : kActionCounts) {
+            for (auto restoreState : { false, true }) {
+                QTest::addRow("%d toolbars/%d actions/%s", toolbarCount, actionCount, restoreState ? "restored" : "default")
+                    << toolbarCount << actionCount << restoreState;
+            }
+        }
+    }
+}
+
+void benchPhase(Phase phase)
+{
+    QFETCH(int, toolbarCount);
+    QFETCH(int, actionCount);
+    QFETCH(bool, restoreState);
+
+    const auto state = restoreState ? savedState(toolbarCount, actionCount) : QByteArray();
+
+    // the first startup loads the style and the platform fonts, it isn't representative
+    startup(toolbarCount, actionCount, state);
+
+    std::vector<qint64> samples;
+    for (int i = 0; i < kSampleCount; ++i) {
+        const auto times = startup(toolbarCount, actionCount, state);
+        QVERIFY2(times.isPainted, "The main window was not painted");
+        switch (phase) {
+        case Phase::Construction:
+            samples.push_back(times.construction);
+            break;
+        case Phase::FirstLayout:
+            samples.push_back(times.firstLayout);
+            break;
+        case Phase::FirstPaint:
+            samples.push_back(times.firstPaint);
+            break;
+        }
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const auto median = samples[samples.size() / 2];
+    qInfo("min %lld ns, median %lld ns, max %lld ns", samples.front(), median, samples.back());
+    QTest::setBenchmarkResult(median, QTest::WalltimeNanoseconds);
+}
+
+} // namespace
+
+class BenchStartup : public QObject
+{
+    Q_OBJECT
+private slots:
+    void benchConstruction_data();
+    void benchConstruction();
+    void benchFirstLayout_data();
+    void benchFirstLayout();
+    void benchFirstPaint_data();
+    void benchFirstPaint();
+};
+
+void BenchStartup::benchConstruction_data()
+{
+    addRows();
+}
+
+void BenchStartup::benchConstruction()
+{
+    benchPhase(Phase::Construction);
+}
+
+void BenchStartup::benchFirstLayout_data()
+{
+    addRows();
+}
+
+void BenchStartup::benchFirstLayout()
+{
+    benchPhase(Phase::FirstLayout);
+}
+
+void BenchStartup::benchFirstPaint_data()
+{
+    addRows();
+}
+
+void BenchStartup::benchFirstPaint()
+{
+    benchPhase(Phase::FirstPaint);
+}
+
+KDTOOLBARS_BENCHMARK_MAIN(BenchStartup)
+#include "bench_startup.moc"
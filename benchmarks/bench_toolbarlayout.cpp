@@ -0,0 +1,282 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "benchmarkmain.h"
+
+#include <kdtoolbars/mainwindow.h>
+#include <kdtoolbars/toolbar.h>
+
+#include <toolbarlayout.h>
+
+#include <QAction>
+#include <QStyle>
+
+#include <limits>
+#include <memory>
+
+using namespace KDToolBars;
+
+enum class LayoutType {
+    Horizontal,
+    Vertical,
+    Columns,
+    Dynamic,
+};
+Q_DECLARE_METATYPE(LayoutType)
+
+namespace {
+
+constexpr int kActionCounts[] = { 10, 100, 1000, 5000 };
+// the dynamic layout search is cubic in the number of items, larger toolbars would take hours
+constexpr int kMaxDynamicActionCount = 500;
+constexpr int kSearchActionCounts[] = { 10, 50, 100, 250, 500 };
+// one separator every that many actions, 0 for none
+constexpr int kSeparatorIntervals[] = { 0, 10, 3 };
+constexpr int kSweepSteps = 50;
+constexpr int kColumns = 4;
+
+const char *layoutTypeName(LayoutType type)
+{
+    switch (type) {
+    case LayoutType::Horizontal:
+        return "horizontal";
+    case LayoutType::Vertical:
+        return "vertical";
+    case LayoutType::Columns:
+        return "columns";
+    case LayoutType::Dynamic:
+        return "dynamic";
+    }
+    return "";
+}
+
+// Docked toolbars live in a main window, floating and column toolbars are top level
+struct Fixture
+{
+    std::unique_ptr<MainWindow> mainWindow;
+    std::unique_ptr<ToolBar> toolbar;
+    ToolBarLayout *layout = nullptr;
+
+    Fixture(LayoutType type, int actionCount, int separatorInterval)
+        : toolbar(std::make_unique<ToolBar>())
+        , layout(static_cast<ToolBarLayout *>(toolbar->layout()))
+    {
+        const auto icon = toolbar->style()->standardIcon(QStyle::SP_FileIcon);
+        for (int i = 0; i < actionCount; ++i) {
+            if (separatorInterval > 0 && i > 0 && i % separatorInterval == 0)
+                toolbar->addSeparator();
+            toolbar->addAction(new QAction(icon, QString::number(i), toolbar.get()));
+        }
+
+        switch (type) {
+        case LayoutType::Horizontal:
+        case LayoutType::Vertical:
+            mainWindow = std::make_unique<MainWindow>();
+            mainWindow->addToolBar(type == LayoutType::Horizontal ? ToolBarTray::Top : ToolBarTray::Left, toolbar.get());
+            break;
+        case LayoutType::Columns:
+            toolbar->setColumns(kColumns);
+            toolbar->setColumnLayout(true);
+            break;
+        case LayoutType::Dynamic:
+            break;
+        }
+
+        QApplication::processEvents(); // process QEvent::LayoutRequest or buttons will be hidden
+        layout->setGeometry(QRect(QPoint(0, 0), layout->sizeHint()));
+    }
+
+    ~Fixture()
+    {
+        // the main window doesn't own the toolbar
+        if (mainWindow)
+            mainWindow->removeToolBar(toolbar.get());
+    }
+};
+
+// sizes from a single column of buttons to a single row
+std::vector<QSize> sweepSizes(ToolBarLayout *layout)
+{
+    const auto narrowest = layout->adjustToWidth(0);
+    const auto widest = layout->adjustToWidth(std::numeric_limits<int>::max());
+    std::vector<QSize> sizes;
+    sizes.reserve(kSweepSteps + 1);
+    for (int i = 0; i <= kSweepSteps; ++i) {
+        const auto width = narrowest.width() + (widest.width() - narrowest.width()) * i / kSweepSteps;
+        const auto height = widest.height() + (narrowest.height() - widest.height()) * i / kSweepSteps;
+        sizes.emplace_back(width, height);
+    }
+    return sizes;
+}
+
+void addRows(bool dynamicOnly)
+{
+    QTest::addColumn<LayoutType>("layoutType");
+    QTest::addColumn<int>("actionCount");
+    QTest::addColumn<int>("separatorInterval");
+
+    for (auto type : { LayoutType::Horizontal, LayoutType::Vertical, LayoutType::Columns, LayoutType::Dynamic }) {
+        if (dynamicOnly && type != LayoutType::Dynamic)
+            continue;
+        for (auto actionCount : kActionCounts) {
+            if (type == LayoutType::Dynamic && actionCount > kMaxDynamicActionCount)
+                continue;
+            for (auto separatorInterval : kSeparatorIntervals) {
+                QTest::addRow("%s/%d actions/separator every %d", layoutTypeName(type), actionCount, separatorInterval)
+                    << type << actionCount << separatorInterval;
+            }
+        }
+    }
+}
+
+} // namespace
+
+class BenchToolBarLayout : public QObject
+{
+    Q_OBJECT
+private slots:
+    void benchSetGeometry_data();
+    void benchSetGeometry();
+    void benchDynamicLayoutSearch_data();
+    void benchDynamicLayoutSearch();
+    void benchAdjustToWidth_data();
+    void benchAdjustToWidth();
+    void benchAdjustToHeight_data();
+    void benchAdjustToHeight();
+    void benchFindDropSite_data();
+    void benchFindDropSite();
+};
+
+void BenchToolBarLayout::benchSetGeometry_data()
+{
+    addRows(false);
+}
+
+void BenchToolBarLayout::benchSetGeometry()
+{
+    QFETCH(LayoutType, layoutType);
+    QFETCH(int, actionCount);
+    QFETCH(int, separatorInterval);
+
+    Fixture fixture(layoutType, actionCount, separatorInterval);
+    auto *layout = fixture.layout;
+    const auto rect = layout->geometry();
+
+    QBENCHMARK {
+        layout->invalidate();
+        layout->setGeometry(rect);
+    }
+}
+
+void BenchToolBarLayout::benchDynamicLayoutSearch_data()
+{
+    QTest::addColumn<LayoutType>("layoutType");
+    QTest::addColumn<int>("actionCount");
+    QTest::addColumn<int>("separatorInterval");
+
+    for (auto actionCount : kSearchActionCounts) {
+        for (auto separatorInterval : kSeparatorIntervals) {
+            QTest::addRow("%d actions/separator every %d", actionCount, separatorInterval)
+                << LayoutType::Dynamic << actionCount << separatorInterval;
+        }
+    }
+}
+
+void BenchToolBarLayout::benchDynamicLayoutSearch()
+{
+    QFETCH(LayoutType, layoutType);
+    QFETCH(int, actionCount);
+    QFETCH(int, separatorInterval);
+
+    Fixture fixture(layoutType, actionCount, separatorInterval);
+    auto *layout = fixture.layout;
+    const auto width = layout->geometry().width() / 2;
+    const auto spacing = layout->spacing();
+
+    // changing the spacing changes the size of the layouts, so the search runs every time
+    int iteration = 0;
+    QBENCHMARK {
+        layout->setSpacing(spacing + (++iteration % 2));
+        layout->adjustToWidth(width);
+    }
+    layout->setSpacing(spacing);
+}
+
+void BenchToolBarLayout::benchAdjustToWidth_data()
+{
+    addRows(true);
+}
+
+void BenchToolBarLayout::benchAdjustToWidth()
+{
+    QFETCH(LayoutType, layoutType);
+    QFETCH(int, actionCount);
+    QFETCH(int, separatorInterval);
+
+    Fixture fixture(layoutType, actionCount, separatorInterval);
+    auto *layout = fixture.layout;
+    const auto sizes = sweepSizes(layout);
+
+    QBENCHMARK {
+        for (const auto &size : sizes)
+            layout->adjustToWidth(size.width());
+    }
+}
+
+void BenchToolBarLayout::benchAdjustToHeight_data()
+{
+    addRows(true);
+}
+
+void BenchToolBarLayout::benchAdjustToHeight()
+{
+    QFETCH(LayoutType, layoutType);
+    QFETCH(int, actionCount);
+    QFETCH(int, separatorInterval);
+
+    Fixture fixture(layoutType, actionCount, separatorInterval);
+    auto *layout = fixture.layout;
+    const auto sizes = sweepSizes(layout);
+
+    QBENCHMARK {
+        for (const auto &size : sizes)
+            layout->adjustToHeight(size.height());
+    }
+}
+
+void BenchToolBarLayout::benchFindDropSite_data()
+{
+    addRows(false);
+}
+
+void BenchToolBarLayout::benchFindDropSite()
+{
+    QFETCH(LayoutType, layoutType);
+    QFETCH(int, actionCount);
+    QFETCH(int, separatorInterval);
+
+    Fixture fixture(layoutType, actionCount, separatorInterval);
+    auto *layout = fixture.layout;
+
+    // points along the diagonal of the layout, hitting every row and column
+    const auto rect = layout->geometry();
+    std::vector<QPoint> points;
+    points.reserve(kSweepSteps + 1);
+    for (int i = 0; i <= kSweepSteps; ++i)
+        points.emplace_back(rect.left() + rect.width() * i / kSweepSteps, rect.top() + rect.height() * i / kSweepSteps);
+
+    QBENCHMARK {
+        for (const auto &point : points)
+            layout->findDropSite(point);
+    }
+}
+
+KDTOOLBARS_BENCHMARK_MAIN(BenchToolBarLayout)
+#include "bench_toolbarlayout.moc"
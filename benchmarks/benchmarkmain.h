@@ -0,0 +1,26 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QApplication>
+#include <QTest>
+
+// Same as QTEST_MAIN, but defaults to the offscreen platform so that benchmarks don't depend on a
+// display or a window manager
+#define KDTOOLBARS_BENCHMARK_MAIN(BenchmarkObject)                        \
+    int main(int argc, char *argv[])                                      \
+    {                                                                     \
+        if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))                \
+            qputenv("QT_QPA_PLATFORM", "offscreen");                      \
+        QApplication app(argc, argv);                                     \
+        BenchmarkObject benchmark;                                        \
+        return QTest::qExec(&benchmark, argc, argv);                      \
+    }
@@ -0,0 +1,58 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "benchmarkwindow.h"
+
+#include <kdtoolbars/toolbar.h>
+
+#include <QAction>
+
+using namespace KDToolBars;
+
+namespace {
+
+bool isEvery(int index, int interval)
+{
+    return interval > 0 && index % interval == interval - 1;
+}
+
+} // namespace
+
+void populateMainWindow(MainWindow *mainWindow, const BenchmarkToolBars &toolbars)
+{
+    Q_ASSERT(!toolbars.trays.empty());
+    Q_ASSERT(toolbars.rowLength > 0 || toolbars.floatingInterval == 0);
+
+    const auto trayCount = static_cast<int>(toolbars.trays.size());
+    QVector<ToolBarPlacement> placements;
+    for (int i = 0; i < toolbars.toolbarCount; ++i) {
+        const bool isCustom = isEvery(i, toolbars.customInterval);
+        auto *toolbar = new ToolBar(isCustom ? ToolBarOption::IsCustom : ToolBarOption::IsCustomizable, mainWindow);
+        toolbar->setObjectName(QStringLiteral("toolbar-%1").arg(i));
+        toolbar->setWindowTitle(QStringLiteral("Toolbar %1").arg(i));
+        for (int j = 0; j < toolbars.actionCount; ++j) {
+            const auto text = QStringLiteral("Action %1.%2").arg(i).arg(j);
+            auto *action = toolbars.icons.empty() ? new QAction(text, toolbar)
+                                                  : new QAction(toolbars.icons[(i + j) % toolbars.icons.size()], text, toolbar);
+            action->setObjectName(QStringLiteral("action-%1-%2").arg(i).arg(j));
+            toolbar->addAction(action);
+        }
+        const auto tray = toolbars.trays[i % trayCount];
+        if (toolbars.rowLength == 0) {
+            mainWindow->addToolBar(tray, toolbar);
+            continue;
+        }
+        const bool isFloating = isEvery(i, toolbars.floatingInterval);
+        placements.append({ toolbar, tray, i / (trayCount * toolbars.rowLength), 0, isFloating,
+                            QRect(QPoint(20 * i, 20 * i), QSize()) });
+    }
+    if (!placements.isEmpty())
+        mainWindow->placeToolBars(placements);
+}
@@ -0,0 +1,38 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <kdtoolbars/mainwindow.h>
+
+#include <QIcon>
+#include <QRect>
+
+#include <vector>
+
+constexpr QRect kWindowGeometry(100, 100, 1024, 768);
+constexpr int kFloatingInterval = 5; // every fifth toolbar is floating
+
+// Toolbars of the main window a benchmark runs on, named toolbar-<n> with actions named
+// action-<n>-<m> so that saved states and recordings can be restored in another main window
+struct BenchmarkToolBars
+{
+    int toolbarCount = 0;
+    int actionCount = 0;
+    std::vector<QIcon> icons; // shared by the actions in turn, actions have no icon if empty
+    int customInterval = 0; // every n-th toolbar is a custom one, none if 0
+    int floatingInterval = 0; // every n-th toolbar is floating, none if 0
+    std::vector<KDToolBars::ToolBarTray> trays = { KDToolBars::ToolBarTray::Top }; // used in turn
+    // toolbars sharing a row in each tray, 0 adds them to the trays one after the other instead of
+    // placing them, which leaves none floating
+    int rowLength = 0;
+};
+
+void populateMainWindow(KDToolBars::MainWindow *mainWindow, const BenchmarkToolBars &toolbars);
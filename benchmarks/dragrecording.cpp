@@ -0,0 +1,185 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "dragrecording.h"
+#include "benchmarkwindow.h"
+
+#include <kdtoolbars/mainwindow.h>
+#include <kdtoolbars/toolbar.h>
+
+#include <qt5qt6compat_p.h>
+
+#include <QApplication>
+#include <QFile>
+#include <QMouseEvent>
+#include <QStyle>
+#include <QTextStream>
+
+using namespace KDToolBars;
+
+namespace {
+constexpr auto kMagic = "kdtoolbars-drag-recording";
+constexpr int kVersion = 1;
+
+QString eventTypeName(QEvent::Type type)
+{
+    switch (type) {
+    case QEvent::MouseButtonPress:
+        return QStringLiteral("press");
+    case QEvent::MouseButtonRelease:
+        return QStringLiteral("release");
+    case QEvent::MouseButtonDblClick:
+        return QStringLiteral("doubleclick");
+    default:
+        return QStringLiteral("move");
+    }
+}
+
+std::optional<QEvent::Type> eventType(const QString &name)
+{
+    if (name == QLatin1String("press"))
+        return QEvent::MouseButtonPress;
+    if (name == QLatin1String("release"))
+        return QEvent::MouseButtonRelease;
+    if (name == QLatin1String("doubleclick"))
+        return QEvent::MouseButtonDblClick;
+    if (name == QLatin1String("move"))
+        return QEvent::MouseMove;
+    return std::nullopt;
+}
+}
+
+bool DragRecording::save(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&file);
+    stream << kMagic << ' ' << kVersion << '\n';
+    stream << "scene " << toolbarCount << ' ' << actionCount << ' ' << windowGeometry.x() << ' ' << windowGeometry.y()
+           << ' ' << windowGeometry.width() << ' ' << windowGeometry.height() << '\n';
+    stream << "initial " << initialState.toBase64() << '\n';
+    for (const auto &event : events) {
+        stream << "event " << event.timestamp << ' ' << eventTypeName(event.type) << ' ' << event.toolbar << ' '
+               << event.globalPos.x() << ' ' << event.globalPos.y() << ' ' << static_cast<int>(event.button) << ' '
+               << static_cast<int>(event.buttons) << '\n';
+    }
+    stream << "final " << finalState.toBase64() << '\n';
+    stream.flush();
+    return stream.status() == QTextStream::Ok;
+}
+
+std::optional<DragRecording> DragRecording::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return std::nullopt;
+
+    QTextStream stream(&file);
+    QString magic;
+    int version;
+    stream >> magic >> version;
+    if (magic != QLatin1String(kMagic) || version != kVersion)
+        return std::nullopt;
+
+    DragRecording recording;
+    while (!stream.atEnd()) {
+        QString tag;
+        stream >> tag;
+        if (tag.isEmpty())
+            continue;
+        if (tag == QLatin1String("scene")) {
+            int x, y, width, height;
+            stream >> recording.toolbarCount >> recording.actionCount >> x >> y >> width >> height;
+            recording.windowGeometry = QRect(x, y, width, height);
+        } else if (tag == QLatin1String("initial") || tag == QLatin1String("final")) {
+            QString data;
+            stream >> data;
+            (tag == QLatin1String("initial") ? recording.initialState : recording.finalState) =
+                QByteArray::fromBase64(data.toLatin1());
+        } else if (tag == QLatin1String("event")) {
+            Event event;
+            QString type;
+            int x, y, button, buttons;
+            stream >> event.timestamp >> type >> event.toolbar >> x >> y >> button >> buttons;
+            const auto parsedType = eventType(type);
+            if (!parsedType)
+                return std::nullopt;
+            event.type = *parsedType;
+            event.globalPos = QPoint(x, y);
+            event.button = static_cast<Qt::MouseButton>(button);
+            event.buttons = static_cast<Qt::MouseButtons>(buttons);
+            recording.events.push_back(event);
+        } else {
+            return std::nullopt;
+        }
+        if (stream.status() != QTextStream::Ok)
+            return std::nullopt;
+    }
+    return recording;
+}
+
+DragRecorder::DragRecorder(MainWindow *mainWindow, int toolbarCount, int actionCount)
+    : m_mainWindow(mainWindow)
+{
+    m_recording.toolbarCount = toolbarCount;
+    m_recording.actionCount = actionCount;
+    m_recording.windowGeometry = mainWindow->geometry();
+    m_recording.initialState = mainWindow->saveToolBarState();
+    m_timer.start();
+    qApp->installEventFilter(this);
+}
+
+DragRecorder::~DragRecorder()
+{
+    qApp->removeEventFilter(this);
+}
+
+DragRecording DragRecorder::recording() const
+{
+    auto recording = m_recording;
+    recording.finalState = m_mainWindow->saveToolBarState();
+    return recording;
+}
+
+bool DragRecorder::eventFilter(QObject *watched, QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseMove: {
+        auto *toolbar = qobject_cast<ToolBar *>(watched);
+        if (toolbar == nullptr)
+            break;
+        const auto *me = static_cast<QMouseEvent *>(event);
+        // hovering doesn't change the layout
+        if (event->type() == QEvent::MouseMove && me->buttons() == Qt::NoButton)
+            break;
+        m_recording.events.push_back({ m_timer.elapsed(), event->type(), toolbar->objectName(),
+                                       Qt5Qt6Compat::eventGlobalPos(me), me->button(), me->buttons() });
+        break;
+    }
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void populateMainWindow(MainWindow *mainWindow, int toolbarCount, int actionCount)
+{
+    BenchmarkToolBars toolbars;
+    toolbars.toolbarCount = toolbarCount;
+    toolbars.actionCount = actionCount;
+    toolbars.icons = { mainWindow->style()->standardIcon(QStyle::SP_FileIcon) };
+    toolbars.trays = { ToolBarTray::Top, ToolBarTray::Top, ToolBarTray::Top, ToolBarTray::Left };
+    populateMainWindow(mainWindow, toolbars);
+}
@@ -0,0 +1,72 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QObject>
+#include <QRect>
+
+#include <optional>
+#include <vector>
+
+namespace KDToolBars {
+class MainWindow;
+}
+
+// Mouse events received by toolbars during a session, and the toolbar state before and after it.
+// Events are stored in global coordinates, replaying them needs a main window populated with the
+// same toolbars at the same geometry.
+struct DragRecording
+{
+    struct Event
+    {
+        qint64 timestamp; // msecs since the start of the session
+        QEvent::Type type;
+        QString toolbar; // object name of the toolbar receiving the event
+        QPoint globalPos;
+        Qt::MouseButton button;
+        Qt::MouseButtons buttons;
+    };
+
+    int toolbarCount = 0;
+    int actionCount = 0;
+    QRect windowGeometry;
+    QByteArray initialState;
+    std::vector<Event> events;
+    QByteArray finalState;
+
+    bool save(const QString &fileName) const;
+    static std::optional<DragRecording> load(const QString &fileName);
+};
+
+// Records the mouse events received by the toolbars of a main window
+class DragRecorder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DragRecorder(KDToolBars::MainWindow *mainWindow, int toolbarCount, int actionCount);
+    ~DragRecorder() override;
+
+    // the recording so far, with the current toolbar state as final state
+    DragRecording recording() const;
+
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    KDToolBars::MainWindow *m_mainWindow;
+    DragRecording m_recording;
+    QElapsedTimer m_timer;
+};
+
+// Toolbars named toolbar-<n> with actions named action-<n>-<m>, every fourth toolbar in the left
+// tray; recording and replaying must use the same main window contents
+void populateMainWindow(KDToolBars::MainWindow *mainWindow, int toolbarCount, int actionCount);
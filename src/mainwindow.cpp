@@ -11,12 +11,21 @@
 #include "mainwindow.h"
 
 #include "mainwindow_p.h"
+#include "toolbarautosaver.h"
 #include "toolbarcontainerlayout.h"
 #include "toolbarcustomizationdialog.h"
+#include "toolbardebugoverlay.h"
+#include "toolbarmemoryusage_p.h"
 #include "toolbar.h"
 #include "toolbartraylayout.h"
+#include "toolbarstatesnapshot_p.h"
+#include "toolbartracer.h"
 
 #include <QIODevice>
+#include <QUndoStack>
+
+#include <algorithm>
+#include <unordered_set>
 
 using namespace KDToolBars;
 
@@ -24,15 +33,23 @@ MainWindow::Private::Private(MainWindow *mainWindow)
     : q(mainWindow)
     , m_container(new QWidget(mainWindow))
     , m_layout(new ToolBarContainerLayout(m_container))
+    , m_autoSaver(std::make_unique<ToolBarAutoSaver>(m_layout))
+    , m_undoStack(new QUndoStack(mainWindow))
+    , m_undoStateCache(m_layout)
 {
     m_layout->setContentsMargins(0, 0, 0, 0);
 
-    connect(m_layout, &ToolBarContainerLayout::toolBarAboutToBeInserted, q, &MainWindow::toolBarAboutToBeInserted);
-    connect(m_layout, &ToolBarContainerLayout::toolBarInserted, q, &MainWindow::toolBarInserted);
-    connect(m_layout, &ToolBarContainerLayout::toolBarAboutToBeRemoved, q, &MainWindow::toolBarAboutToBeRemoved);
-    connect(m_layout, &ToolBarContainerLayout::toolBarRemoved, q, &MainWindow::toolBarRemoved);
+    m_connections = {
+        connect(m_layout, &ToolBarContainerLayout::toolBarAboutToBeInserted, q, &MainWindow::toolBarAboutToBeInserted),
+        connect(m_layout, &ToolBarContainerLayout::toolBarInserted, q, &MainWindow::toolBarInserted),
+        connect(m_layout, &ToolBarContainerLayout::toolBarAboutToBeRemoved, q, &MainWindow::toolBarAboutToBeRemoved),
+        connect(m_layout, &ToolBarContainerLayout::toolBarRemoved, q, &MainWindow::toolBarRemoved),
+        connect(m_layout, &ToolBarContainerLayout::toolBarRemoved, q, [this] { m_undoStateCache.prune(); }),
+    };
 }
 
+MainWindow::Private::~Private() = default;
+
 void MainWindow::Private::setCustomizingToolBars(bool customizing)
 {
     if (customizing == m_customizingToolBars)
@@ -41,6 +58,80 @@ void MainWindow::Private::setCustomizingToolBars(bool customizing)
     emit q->customizingToolBarsChanged(customizing);
 }
 
+void MainWindow::Private::connectToolBar(ToolBar *toolbar)
+{
+    QObject::disconnect(q, &QMainWindow::iconSizeChanged, toolbar, &ToolBar::updateIconSize);
+    QObject::disconnect(q, &QMainWindow::toolButtonStyleChanged, toolbar, &ToolBar::updateToolButtonStyle);
+
+    toolbar->updateIconSize(q->iconSize());
+    toolbar->updateToolButtonStyle(q->toolButtonStyle());
+    // connections of toolbars that were removed or destroyed since are broken
+    m_connections.erase(std::remove_if(m_connections.begin(), m_connections.end(), [](const QMetaObject::Connection &connection) {
+                            return !connection;
+                        }),
+                        m_connections.end());
+    m_connections.push_back(QObject::connect(q, &QMainWindow::iconSizeChanged, toolbar, &ToolBar::updateIconSize));
+    m_connections.push_back(QObject::connect(q, &QMainWindow::toolButtonStyleChanged, toolbar, &ToolBar::updateToolButtonStyle));
+}
+
+bool MainWindow::Private::canResetToolBar(const ToolBar *toolbar) const
+{
+    if (!m_defaultState.isValid() || (toolbar->options() & ToolBarOption::IsCustom))
+        return false;
+    return ToolBarContainerLayout::hasToolBarState(m_defaultState.d->trayStates, toolbar);
+}
+
+void MainWindow::Private::resetToolBar(ToolBar *toolbar)
+{
+    if (!m_resettingToolBars && canResetToolBar(toolbar))
+        m_layout->resetToolBar(toolbar, m_defaultState.d->trayStates);
+}
+
+void MainWindow::Private::beginActionsUndoStep()
+{
+    m_actionsUndoStep.emplace();
+}
+
+void MainWindow::Private::addToActionsUndoStep(ToolBar *toolbar)
+{
+    if (!m_actionsUndoStep)
+        return;
+    auto &toolbars = *m_actionsUndoStep;
+    const auto isAdded = std::any_of(toolbars.begin(), toolbars.end(), [toolbar](const auto &entry) {
+        return entry.first == toolbar;
+    });
+    if (!isAdded)
+        toolbars.emplace_back(toolbar, m_undoStateCache.state(toolbar));
+}
+
+void MainWindow::Private::endActionsUndoStep(const QString &text)
+{
+    if (!m_actionsUndoStep)
+        return;
+    std::vector<ToolBarActionsCommand::Change> changes;
+    for (const auto &[toolbar, before] : *m_actionsUndoStep) {
+        if (toolbar.isNull())
+            continue;
+        // the cache hands out the same state if the toolbar didn't change
+        auto after = m_undoStateCache.state(toolbar);
+        if (after == before)
+            continue;
+        changes.push_back({ ToolBarContainerLayout::toolBarId(toolbar), before, std::move(after) });
+    }
+    m_actionsUndoStep.reset();
+    if (!changes.empty()) {
+        m_undoStack->push(new ToolBarActionsCommand(m_layout, std::move(changes), text));
+        emit m_layout->stateChanged();
+    }
+}
+
+void MainWindow::Private::clearUndoStack()
+{
+    m_undoStack->clear();
+    // custom toolbars that weren't restored are deleted without leaving the layout on their own
+    m_undoStateCache.prune();
+}
+
 MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
     : QMainWindow(parent, flags)
     , d(new Private(this))
@@ -65,29 +156,15 @@ void MainWindow::addToolBar(ToolBar *toolbar)
 
 void MainWindow::addToolBar(ToolBarTray tray, ToolBar *toolbar)
 {
-    disconnect(this, &QMainWindow::iconSizeChanged, toolbar, &ToolBar::updateIconSize);
-    disconnect(this, &QMainWindow::toolButtonStyleChanged, toolbar, &ToolBar::updateToolButtonStyle);
     d->m_layout->removeToolBar(toolbar);
-
-    toolbar->updateIconSize(iconSize());
-    toolbar->updateToolButtonStyle(toolButtonStyle());
-    connect(this, &QMainWindow::iconSizeChanged, toolbar, &ToolBar::updateIconSize);
-    connect(this, &QMainWindow::toolButtonStyleChanged, toolbar, &ToolBar::updateToolButtonStyle);
-
+    d->connectToolBar(toolbar);
     d->m_layout->addToolBar(tray, toolbar);
 }
 
 void MainWindow::insertToolBar(ToolBar *before, ToolBar *toolbar)
 {
-    disconnect(this, &QMainWindow::iconSizeChanged, toolbar, &ToolBar::updateIconSize);
-    disconnect(this, &QMainWindow::toolButtonStyleChanged, toolbar, &ToolBar::updateToolButtonStyle);
     d->m_layout->removeToolBar(toolbar);
-
-    toolbar->updateIconSize(iconSize());
-    toolbar->updateToolButtonStyle(toolButtonStyle());
-    connect(this, &QMainWindow::iconSizeChanged, toolbar, &ToolBar::updateIconSize);
-    connect(this, &QMainWindow::toolButtonStyleChanged, toolbar, &ToolBar::updateToolButtonStyle);
-
+    d->connectToolBar(toolbar);
     d->m_layout->insertToolBar(before, toolbar);
 }
 
@@ -110,12 +187,48 @@ void MainWindow::removeToolBar(ToolBar *toolbar)
     toolbar->hide();
 }
 
+void MainWindow::placeToolBars(const QVector<ToolBarPlacement> &placements)
+{
+    std::vector<ToolBar *> newToolBars;
+    for (const auto &placement : placements) {
+        if (placement.toolbar != nullptr && d->m_layout->toolBarTray(placement.toolbar) == nullptr)
+            newToolBars.push_back(placement.toolbar);
+    }
+    d->m_layout->placeToolBars(placements);
+
+    // toolbars with an invalid placement weren't added
+    for (auto *toolbar : newToolBars) {
+        if (d->m_layout->toolBarTray(toolbar) != nullptr)
+            d->connectToolBar(toolbar);
+    }
+}
+
 ToolBarTray MainWindow::toolBarTray(const ToolBar *toolbar) const
 {
     auto *tray = d->m_layout->toolBarTray(toolbar);
     return tray != nullptr ? tray->tray() : ToolBarTray::None;
 }
 
+void MainWindow::setToolBarLayoutLocked(bool locked)
+{
+    d->m_layout->setLocked(locked);
+}
+
+bool MainWindow::isToolBarLayoutLocked() const
+{
+    return d->m_layout->isLocked();
+}
+
+void MainWindow::setToolBarRowPackingEnabled(bool enabled)
+{
+    d->m_layout->setRowPackingEnabled(enabled);
+}
+
+bool MainWindow::isToolBarRowPackingEnabled() const
+{
+    return d->m_layout->isRowPackingEnabled();
+}
+
 int MainWindow::toolBarCount() const
 {
     return d->m_layout->toolBarCount();
@@ -137,7 +250,219 @@ QByteArray MainWindow::saveToolBarState() const
 bool MainWindow::restoreToolBarState(const QByteArray &state)
 {
     QDataStream stream(state);
-    return d->m_layout->restoreState(stream);
+    if (!d->m_layout->restoreState(stream))
+        return false;
+    d->clearUndoStack();
+    return true;
+}
+
+bool MainWindow::restoreToolBarState(const ToolBarStateSnapshot &snapshot)
+{
+    if (!snapshot.isValid())
+        return false;
+    d->m_layout->applyState(snapshot.d->trayStates);
+    d->clearUndoStack();
+    return true;
+}
+
+ToolBarStateSnapshot MainWindow::captureToolBarState() const
+{
+    ToolBarStateSnapshot snapshot;
+    snapshot.d = std::make_shared<ToolBarStateSnapshot::Data>(ToolBarStateSnapshot::Data { d->m_layout->state() });
+    return snapshot;
+}
+
+void MainWindow::registerToolBarPerspective(const QString &name, const ToolBarStateSnapshot &snapshot)
+{
+    if (!snapshot.isValid()) {
+        qWarning("MainWindow::registerToolBarPerspective: Invalid snapshot for perspective %s", qPrintable(name));
+        return;
+    }
+    d->m_perspectives[name] = snapshot;
+}
+
+void MainWindow::captureToolBarPerspective(const QString &name)
+{
+    d->m_perspectives[name] = captureToolBarState();
+}
+
+bool MainWindow::activateToolBarPerspective(const QString &name)
+{
+    auto it = d->m_perspectives.constFind(name);
+    if (it == d->m_perspectives.constEnd())
+        return false;
+    return restoreToolBarState(it.value());
+}
+
+void MainWindow::removeToolBarPerspective(const QString &name)
+{
+    d->m_perspectives.remove(name);
+}
+
+QUndoStack *MainWindow::toolBarUndoStack() const
+{
+    return d->m_undoStack;
+}
+
+void MainWindow::captureDefaultToolBarState()
+{
+    d->m_defaultState = captureToolBarState();
+}
+
+ToolBarStateSnapshot MainWindow::defaultToolBarState() const
+{
+    return d->m_defaultState;
+}
+
+void MainWindow::resetToolBars()
+{
+    if (d->m_defaultState.isValid())
+        d->m_layout->resetToolBars(d->m_defaultState.d->trayStates);
+
+    // every toolbar is reset as if it was reset on its own, subclasses may reset more than their
+    // place and actions, and toolbars that aren't part of the default state may still know how to
+    // reset themselves
+    std::vector<ToolBar *> toolbars;
+    for (int i = 0, count = toolBarCount(); i < count; ++i) {
+        auto *toolbar = toolBarAt(i);
+        if (toolbar->canBeReset())
+            toolbars.push_back(toolbar);
+    }
+    d->m_resettingToolBars = true;
+    for (auto *toolbar : toolbars)
+        toolbar->reset();
+    d->m_resettingToolBars = false;
+
+    d->clearUndoStack();
+}
+
+QStringList MainWindow::toolBarPerspectives() const
+{
+    return d->m_perspectives.keys();
+}
+
+ToolBarStateSnapshot MainWindow::toolBarPerspective(const QString &name) const
+{
+    return d->m_perspectives.value(name);
+}
+
+int MainWindow::lastRestoreChangeCount() const
+{
+    return d->m_layout->lastRestoreChanges();
+}
+
+ToolBarPerformanceCounters MainWindow::toolBarPerformanceCounters() const
+{
+    return *d->m_layout->performanceCounters();
+}
+
+void MainWindow::resetToolBarPerformanceCounters()
+{
+    *d->m_layout->performanceCounters() = {};
+}
+
+ToolBarMemoryUsage MainWindow::toolBarMemoryUsage() const
+{
+    ToolBarMemoryUsage usage;
+    IconPixmapKeys pixmapKeys;
+    const auto count = d->m_layout->toolBarCount();
+    for (int i = 0; i < count; ++i)
+        d->m_layout->toolBarAt(i)->d->addMemoryUsage(usage, pixmapKeys);
+
+    usage.connectionCount += connectedCount(d->m_connections) + d->m_autoSaver->connectionCount()
+        + d->m_layout->actionRegistryConnectionCount();
+    if (d->m_debugOverlay != nullptr)
+        usage.connectionCount += d->m_debugOverlay->connectionCount();
+
+    // perspectives copied from the default state and consecutive undo steps share their states,
+    // count each of them once
+    std::unordered_set<const ToolBarStateSnapshot::Data *> snapshots;
+    const auto addSnapshot = [&snapshots, &usage](const ToolBarStateSnapshot &snapshot) {
+        if (!snapshot.d || !snapshots.insert(snapshot.d.get()).second)
+            return;
+        usage.stateBytes += sizeof(ToolBarStateSnapshot::Data);
+        for (const auto &trayState : snapshot.d->trayStates)
+            usage.stateBytes += heapBytes(trayState);
+    };
+    addSnapshot(d->m_defaultState);
+    for (const auto &perspective : d->m_perspectives)
+        addSnapshot(perspective);
+
+    ToolBarStateSet states;
+    d->m_undoStateCache.addStates(states);
+    for (int i = 0; i < d->m_undoStack->count(); ++i)
+        addUndoStates(d->m_undoStack->command(i), states);
+    if (d->m_actionsUndoStep) {
+        for (const auto &step : *d->m_actionsUndoStep)
+            states.insert(step.second.get());
+    }
+    for (const auto *state : states)
+        usage.stateBytes += sizeof(ToolBarState) + heapBytes(*state);
+
+    return usage;
+}
+
+void MainWindow::startToolBarTrace()
+{
+    d->m_layout->startTracing();
+}
+
+bool MainWindow::stopToolBarTrace(const QString &fileName)
+{
+    const auto tracer = d->m_layout->stopTracing();
+    if (!tracer) {
+        qWarning("MainWindow::stopToolBarTrace: Not tracing");
+        return false;
+    }
+    return tracer->save(fileName);
+}
+
+bool MainWindow::isToolBarTraceActive() const
+{
+    return d->m_layout->tracer() != nullptr;
+}
+
+void MainWindow::setToolBarDebugOverlayVisible(bool visible)
+{
+    if (visible == isToolBarDebugOverlayVisible())
+        return;
+    if (visible) {
+        d->m_debugOverlay = new ToolBarDebugOverlay(d->m_layout, d->m_container);
+        d->m_debugOverlay->show();
+    } else {
+        delete d->m_debugOverlay;
+        d->m_debugOverlay = nullptr;
+    }
+}
+
+bool MainWindow::isToolBarDebugOverlayVisible() const
+{
+    return d->m_debugOverlay != nullptr;
+}
+
+void MainWindow::setToolBarAutoSaveFileName(const QString &fileName)
+{
+    d->m_autoSaver->setFileName(fileName);
+}
+
+QString MainWindow::toolBarAutoSaveFileName() const
+{
+    return d->m_autoSaver->fileName();
+}
+
+void MainWindow::setToolBarAutoSaveDelay(int msec)
+{
+    d->m_autoSaver->setDelay(msec);
+}
+
+int MainWindow::toolBarAutoSaveDelay() const
+{
+    return d->m_autoSaver->delay();
+}
+
+void MainWindow::flushToolBarAutoSave()
+{
+    d->m_autoSaver->flush();
 }
 
 bool MainWindow::isCustomizingToolBars() const
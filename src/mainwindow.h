@@ -11,8 +11,14 @@
 #pragma once
 
 #include "kdtoolbars_export.h"
+#include "toolbarmemoryusage.h"
+#include "toolbarperformancecounters.h"
+#include "toolbarstatesnapshot.h"
 
 #include <QMainWindow>
+#include <QVector>
+
+class QUndoStack;
 
 namespace KDToolBars {
 
@@ -31,6 +37,17 @@ enum class ToolBarTray {
 Q_DECLARE_FLAGS(ToolBarTrays, ToolBarTray);
 Q_DECLARE_OPERATORS_FOR_FLAGS(ToolBarTrays);
 
+// Explicit position of a toolbar, used by MainWindow::placeToolBars
+struct ToolBarPlacement
+{
+    ToolBar *toolbar = nullptr;
+    ToolBarTray tray = ToolBarTray::Top;
+    int row = 0;
+    int pos = 0; // offset of the toolbar within the row
+    bool isFloating = false;
+    QRect floatingGeometry; // only used if isFloating is set, an empty size keeps the current size
+};
+
 class KDTOOLBARS_EXPORT MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -47,13 +64,80 @@ public:
     void insertToolBarBreak(ToolBar *before);
     void removeToolBar(ToolBar *toolbar);
 
+    // Move all the given toolbars to their explicit positions and lay out the trays once
+    void placeToolBars(const QVector<ToolBarPlacement> &placements);
+
     ToolBarTray toolBarTray(const ToolBar *toolbar) const;
 
+    // Locked toolbars can't be moved, resized or customized, and docked toolbars have no handle
+    void setToolBarLayoutLocked(bool locked);
+    bool isToolBarLayoutLocked() const;
+
+    // Wrap toolbars that don't fit in the window to new lines within their row
+    void setToolBarRowPackingEnabled(bool enabled);
+    bool isToolBarRowPackingEnabled() const;
+
     int toolBarCount() const;
     ToolBar *toolBarAt(int index) const;
 
     QByteArray saveToolBarState() const;
     bool restoreToolBarState(const QByteArray &state);
+    // Applies a snapshot decoded beforehand, possibly on another thread
+    bool restoreToolBarState(const ToolBarStateSnapshot &snapshot);
+    ToolBarStateSnapshot captureToolBarState() const;
+
+    // Named toolbar arrangements kept decoded in memory; activating one only changes what differs
+    // from the current arrangement
+    void registerToolBarPerspective(const QString &name, const ToolBarStateSnapshot &snapshot);
+    void captureToolBarPerspective(const QString &name);
+    bool activateToolBarPerspective(const QString &name);
+    void removeToolBarPerspective(const QString &name);
+    QStringList toolBarPerspectives() const;
+    ToolBarStateSnapshot toolBarPerspective(const QString &name) const;
+    // The state toolbars go back to when they're reset, usually captured once the application has
+    // set up its toolbars; resetting all toolbars restores it in a single pass
+    void captureDefaultToolBarState();
+    ToolBarStateSnapshot defaultToolBarState() const;
+    void resetToolBars();
+
+    // Number of toolbars, buttons and separators created, moved or removed by the last restore,
+    // restoring the state that is already on screen touches none
+    int lastRestoreChangeCount() const;
+
+    // Live counters of the layout work done for the toolbars of this window, cheap enough to be
+    // sampled at runtime
+    ToolBarPerformanceCounters toolBarPerformanceCounters() const;
+    void resetToolBarPerformanceCounters();
+
+    // Memory held by all the toolbars of this window, plus the connections of the window itself and
+    // the default state, perspectives and undo steps it keeps
+    ToolBarMemoryUsage toolBarMemoryUsage() const;
+
+    // Records spans of toolbar layout passes, toolbar moves, docking, action drags and restores
+    // until stopped, then writes them as Chrome trace events that can be opened in Perfetto or
+    // chrome://tracing
+    void startToolBarTrace();
+    bool stopToolBarTrace(const QString &fileName);
+    bool isToolBarTraceActive() const;
+
+    // Overlay drawn on top of the docked toolbars with the layout time per pass, the layout passes
+    // per second, the widgets of every toolbar and what is being dragged, to see when a
+    // configuration does more work than it should
+    void setToolBarDebugOverlayVisible(bool visible);
+    bool isToolBarDebugOverlayVisible() const;
+
+    // Save the toolbar state to a file once it hasn't changed for the given delay, serializing and
+    // writing it on a worker thread; an empty file name disables autosaving
+    void setToolBarAutoSaveFileName(const QString &fileName);
+    QString toolBarAutoSaveFileName() const;
+    void setToolBarAutoSaveDelay(int msec);
+    int toolBarAutoSaveDelay() const;
+    // Writes pending changes right away and waits until they're on disk
+    void flushToolBarAutoSave();
+
+    // Customizations made by dragging actions or in the customization dialog, each step only holds
+    // the state of the toolbars it changed
+    QUndoStack *toolBarUndoStack() const;
 
     bool isCustomizingToolBars() const;
     void customizeToolBars();
@@ -11,22 +11,54 @@
 #pragma once
 
 #include "mainwindow.h"
+#include "toolbarundocommands.h"
+
+#include <QMap>
+#include <QPointer>
+
+#include <memory>
+#include <optional>
+#include <vector>
 
 namespace KDToolBars {
 
+class ToolBarAutoSaver;
 class ToolBarContainerLayout;
+class ToolBarDebugOverlay;
 
 class MainWindow::Private
 {
 public:
     explicit Private(MainWindow *mainWindow);
+    ~Private();
 
     void setCustomizingToolBars(bool customizing);
+    void connectToolBar(ToolBar *toolbar);
+    bool canResetToolBar(const ToolBar *toolbar) const;
+    void resetToolBar(ToolBar *toolbar);
+
+    // actions dragged while customizing toolbars are recorded as a single undo step, holding the
+    // state of the toolbars they touched before and after
+    void beginActionsUndoStep();
+    void addToActionsUndoStep(ToolBar *toolbar);
+    void endActionsUndoStep(const QString &text);
+    // once the toolbars are restored or reset, undo steps would bring back the toolbars they knew
+    void clearUndoStack();
 
     MainWindow *const q;
     QWidget *m_container;
     ToolBarContainerLayout *m_layout;
+    std::unique_ptr<ToolBarAutoSaver> m_autoSaver;
     bool m_customizingToolBars = false;
+    bool m_resettingToolBars = false; // the layout is reset in a single pass, toolbars only reset themselves
+    QMap<QString, ToolBarStateSnapshot> m_perspectives;
+    ToolBarStateSnapshot m_defaultState;
+    QUndoStack *m_undoStack;
+    ToolBarStateCache m_undoStateCache;
+    std::optional<std::vector<std::pair<QPointer<ToolBar>, SharedToolBarState>>> m_actionsUndoStep;
+    ToolBarDebugOverlay *m_debugOverlay = nullptr; // owned by the container, only exists while shown
+    // made by the constructor and connectToolBar(), counted in the memory usage
+    std::vector<QMetaObject::Connection> m_connections;
 };
 
 } // namespace KDToolBars
@@ -13,7 +13,11 @@
 #include "toolbar_p.h"
 #include "toolbarlayout.h"
 #include "toolbarseparator.h"
+#include "toolbarstatecodec.h"
+#include "toolbartracer.h"
+#include "tracehooks_p.h"
 #include "toolbarcontainerlayout.h"
+#include "toolbarperformancecounters_p.h"
 #include "mainwindow.h"
 #include "mainwindow_p.h"
 #include "qt5qt6compat_p.h"
@@ -22,6 +26,7 @@
 #include <QApplication>
 #include <QDrag>
 #include <QPainter>
+#include <QSet>
 #include <QStyle>
 #include <QStyleOption>
 #include <QStyleOptionToolBar>
@@ -37,6 +42,12 @@ static void initKDToolBarsResources() // NOLINT
 }
 
 namespace {
+quint64 nextToolBarId()
+{
+    static quint64 lastId = 0;
+    return ++lastId;
+}
+
 MainWindow *mainWindow(const ToolBar *tb)
 {
     auto *w = tb->parentWidget();
@@ -56,6 +67,29 @@ QIcon buttonIcon(const QString &iconName)
     icon.addFile(QStringLiteral(":/img/%1-2x.png").arg(iconName));
     return icon;
 }
+
+// mask of the elements of a longest strictly increasing subsequence of values
+std::vector<bool> longestIncreasingSubsequence(const std::vector<int> &values)
+{
+    // tails[k] is the index of the smallest tail of an increasing subsequence of length k + 1
+    std::vector<int> tails;
+    std::vector<int> predecessors(values.size(), -1);
+    for (int i = 0; i < static_cast<int>(values.size()); ++i) {
+        auto it = std::lower_bound(tails.begin(), tails.end(), values[i], [&values](int index, int value) {
+            return values[index] < value;
+        });
+        if (it != tails.begin())
+            predecessors[i] = *std::prev(it);
+        if (it == tails.end())
+            tails.push_back(i);
+        else
+            *it = i;
+    }
+    std::vector<bool> mask(values.size(), false);
+    for (int i = tails.empty() ? -1 : tails.back(); i != -1; i = predecessors[i])
+        mask[i] = true;
+    return mask;
+}
 } // namespace
 
 namespace KDToolBars {
@@ -83,6 +117,7 @@ protected:
 ToolBar::Private::Private(ToolBarOptions options, ToolBar *toolbar)
     : q(toolbar)
     , m_options(options)
+    , m_id(nextToolBarId())
 {
 }
 
@@ -118,11 +153,11 @@ void ToolBar::Private::init()
         q->setMinimumHeight(height);
         m_layout->setMinimumSize(buttonSize);
     };
-    QObject::connect(q, &ToolBar::iconSizeChanged, q, updateMinimumHeight);
+    m_connections[0] = QObject::connect(q, &ToolBar::iconSizeChanged, q, updateMinimumHeight);
     updateMinimumHeight();
 
     // Resize toolbar when icon size changes
-    QObject::connect(q, &ToolBar::iconSizeChanged, q, [this] {
+    m_connections[1] = QObject::connect(q, &ToolBar::iconSizeChanged, q, [this] {
         if (q->isFloating()) {
             // Postpone resizing because we want it to happen after the buttons have been resized
             QTimer::singleShot(
@@ -136,7 +171,7 @@ void ToolBar::Private::init()
     m_closeButton->setAutoRaise(true);
     m_closeButton->setFocusPolicy(Qt::NoFocus);
     m_closeButton->setIcon(buttonIcon(QStringLiteral("close")));
-    QObject::connect(m_closeButton, &QAbstractButton::clicked, q, &QWidget::close);
+    m_connections[2] = QObject::connect(m_closeButton, &QAbstractButton::clicked, q, &QWidget::close);
     m_layout->setCloseButton(m_closeButton);
 
     m_dropIndicator = new DropIndicator(q);
@@ -176,6 +211,21 @@ void ToolBar::Private::resizeEnd()
 {
     m_resizeMargin = Margin::None;
     q->setCursor(Qt::ArrowCursor);
+    ToolBarContainerLayout::notifyStateChanged(q);
+}
+
+void ToolBar::Private::endDrag()
+{
+    Q_ASSERT(m_isDragging);
+    q->releaseMouse();
+    qApp->removeEventFilter(this);
+    if (!q->isFloating()) {
+        auto *mw = mainWindow(q);
+        Q_ASSERT(mw);
+        mw->d->m_layout->adjustToolBarRow(q);
+    }
+    m_isDragging = false;
+    ToolBarContainerLayout::notifyStateChanged(q);
 }
 
 void ToolBar::Private::dragMargin(QPoint p)
@@ -239,12 +289,29 @@ void ToolBar::Private::actionEvent(QActionEvent *event)
     QAction *action = event->action();
     switch (event->type()) {
     case QEvent::ActionAdded: {
+        if (m_deferActionWidgets) {
+            // the widget is created when the toolbar is shown, one stashed while moving the action
+            // is dropped
+            auto it = m_stashedActionWidgets.find(action);
+            if (it != m_stashedActionWidgets.end()) {
+                destroyActionWidget(action, it->second);
+                m_stashedActionWidgets.erase(it);
+            }
+            break;
+        }
         int index = m_layout->count() - 1; // count includes the close button
         if (event->before()) {
             index = m_layout->indexOf(widgetForAction(event->before()));
             Q_ASSERT(index != -1);
         }
-        auto item = createWidgetForAction(action);
+        auto item = [this, action] {
+            auto it = m_stashedActionWidgets.find(action);
+            if (it == m_stashedActionWidgets.end())
+                return createWidgetForAction(action);
+            const auto item = it->second;
+            m_stashedActionWidgets.erase(it);
+            return item;
+        }();
         m_layout->insertWidget(index, item.widget, item.type);
         m_actionWidgets[action] = item;
         break;
@@ -255,16 +322,18 @@ void ToolBar::Private::actionEvent(QActionEvent *event)
     }
     case QEvent::ActionRemoved: {
         auto it = m_actionWidgets.find(action);
-        Q_ASSERT(it != m_actionWidgets.end());
+        if (it == m_actionWidgets.end()) {
+            Q_ASSERT(m_deferActionWidgets);
+            break;
+        }
         const auto item = it->second;
         m_layout->removeWidget(item.widget);
         m_actionWidgets.erase(it);
-        if (item.type == ToolBarLayout::ToolBarWidgetType::CustomWidget) {
-            if (auto *widgetAction = qobject_cast<QWidgetAction *>(action))
-                widgetAction->releaseWidget(item.widget);
-        } else {
-            delete item.widget;
+        if (m_stashActionWidgets) {
+            m_stashedActionWidgets[action] = item;
+            break;
         }
+        destroyActionWidget(action, item);
         break;
     }
     default:
@@ -272,8 +341,19 @@ void ToolBar::Private::actionEvent(QActionEvent *event)
     }
 }
 
+void ToolBar::Private::destroyActionWidget(QAction *action, const ActionWidget &item)
+{
+    if (item.type == ToolBarLayout::ToolBarWidgetType::CustomWidget) {
+        if (auto *widgetAction = qobject_cast<QWidgetAction *>(action))
+            widgetAction->releaseWidget(item.widget);
+    } else {
+        delete item.widget;
+    }
+}
+
 bool ToolBar::Private::mousePressEvent(const QMouseEvent *me)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBar::Private::mousePressEvent");
     if (me->button() != Qt::LeftButton)
         return false;
 
@@ -302,6 +382,7 @@ bool ToolBar::Private::mousePressEvent(const QMouseEvent *me)
 
 bool ToolBar::Private::mouseMoveEvent(const QMouseEvent *me)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBar::Private::mouseMoveEvent");
     if (q->isFloating() && isResizing()) {
         dragMargin(Qt5Qt6Compat::eventGlobalPos(me));
         return true;
@@ -327,21 +408,14 @@ bool ToolBar::Private::mouseMoveEvent(const QMouseEvent *me)
 
 bool ToolBar::Private::mouseReleaseEvent(const QMouseEvent *)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBar::Private::mouseReleaseEvent");
     if (isResizing()) {
         resizeEnd();
         return true;
     }
 
     if (m_isDragging) {
-        q->releaseMouse();
-        qApp->removeEventFilter(this);
-        if (!q->isFloating()) {
-            auto *mw = mainWindow(q);
-            Q_ASSERT(mw);
-            mw->d->m_layout->adjustToolBarRow(q);
-        }
-        m_isDragging = false;
-
+        endDrag();
         return true;
     }
 
@@ -350,6 +424,7 @@ bool ToolBar::Private::mouseReleaseEvent(const QMouseEvent *)
 
 bool ToolBar::Private::mouseDoubleClickEvent(const QMouseEvent *me)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBar::Private::mouseDoubleClickEvent");
     if (me->button() != Qt::LeftButton)
         return false;
     const auto shouldDock = q->isFloating() && titleArea().contains(Qt5Qt6Compat::eventPos(me));
@@ -363,6 +438,7 @@ bool ToolBar::Private::mouseDoubleClickEvent(const QMouseEvent *me)
 
 bool ToolBar::Private::hoverMoveEvent(const QHoverEvent *he)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBar::Private::hoverMoveEvent");
     if (!isResizing()) {
         const auto cursor = [this, he] {
             if (q->isFloating() && isResizable()) {
@@ -391,6 +467,7 @@ bool ToolBar::Private::hoverMoveEvent(const QHoverEvent *he)
 
 void ToolBar::Private::dragEnterEvent(QDragEnterEvent *e)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBar::Private::dragEnterEvent");
     auto *data = qobject_cast<const ToolbarActionMimeData *>(e->mimeData());
     if (data == nullptr || !q->canDropAction(data->action))
         return;
@@ -402,6 +479,7 @@ void ToolBar::Private::dragEnterEvent(QDragEnterEvent *e)
 
 void ToolBar::Private::dragMoveEvent(QDragMoveEvent *e)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBar::Private::dragMoveEvent");
     auto *data = qobject_cast<const ToolbarActionMimeData *>(e->mimeData());
     if (data != nullptr && q->canDropAction(data->action) && updateDropIndicatorGeometry(Qt5Qt6Compat::eventPos(e)))
         e->accept();
@@ -446,11 +524,13 @@ bool ToolBar::Private::updateDropIndicatorGeometry(QPoint pos)
 
 void ToolBar::Private::dragLeaveEvent(QDragLeaveEvent *)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBar::Private::dragLeaveEvent");
     m_dropIndicator->hide();
 }
 
 void ToolBar::Private::dropEvent(QDropEvent *e)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBar::Private::dropEvent");
     m_dropIndicator->hide();
 
     auto *sourceToolbar = qobject_cast<ToolBar *>(e->source());
@@ -464,12 +544,18 @@ void ToolBar::Private::dropEvent(QDropEvent *e)
     if (!q->canDropAction(actionToInsert))
         return;
 
+    ScopedTraceSpan span(ToolBarContainerLayout::tracer(q), "actionDrop", "customization", q);
+
     const auto dropSite = m_layout->findDropSite(Qt5Qt6Compat::eventPos(e));
     const auto position = dropSite.itemIndex;
 
     const auto actions = q->actions();
     QAction *beforeAction = position < actions.count() ? actions[position] : nullptr;
 
+    // the drag started by the source toolbar records the undo step
+    if (auto *mw = mainWindow(q))
+        mw->d->addToActionsUndoStep(q);
+
     if (e->dropAction() == Qt::MoveAction) {
         if (beforeAction != actionToInsert) {
             sourceToolbar->removeAction(actionToInsert);
@@ -488,11 +574,34 @@ void ToolBar::Private::dropEvent(QDropEvent *e)
 
 bool ToolBar::Private::canCustomize() const
 {
+    if (m_locked)
+        return false;
     auto *mw = mainWindow(q);
     Q_ASSERT(mw);
     return mw->isCustomizingToolBars();
 }
 
+void ToolBar::Private::setLocked(bool locked)
+{
+    if (locked == m_locked)
+        return;
+    m_locked = locked;
+
+    // no need to track hover events or accept drops if the toolbar can't be changed
+    q->setAttribute(Qt::WA_Hover, !locked);
+    q->setAcceptDrops(!locked);
+    if (locked) {
+        if (isResizing())
+            resizeEnd();
+        if (m_isDragging)
+            endDrag();
+        q->unsetCursor();
+    }
+
+    m_layout->setHandleVisible(!locked);
+    q->update();
+}
+
 QRect ToolBar::Private::titleArea() const
 {
     return m_layout->titleArea().translated(q->contentsRect().topLeft());
@@ -524,6 +633,9 @@ void ToolBar::Private::dock()
 
 void ToolBar::Private::setWindowState(bool floating, QPoint pos)
 {
+    ScopedPerformanceCounter counter(ToolBarContainerLayout::performanceCounters(q), &ToolBarPerformanceCounters::dockTransitions);
+    ScopedTraceSpan span(ToolBarContainerLayout::tracer(q), floating ? "undock" : "dock", "dock", q);
+
     if (m_isDragging) {
         q->releaseMouse();
     }
@@ -566,6 +678,7 @@ void ToolBar::Private::setWindowState(bool floating, QPoint pos)
     }
 
     emit q->isFloatingChanged(floating);
+    ToolBarContainerLayout::notifyStateChanged(q);
 }
 
 void ToolBar::Private::offsetDragPosition(QPoint offset)
@@ -607,6 +720,10 @@ bool ToolBar::Private::eventFilter(QObject *watched, QEvent *event)
         return false;
     }
 
+    // action widgets can't be dragged while locked, skip the action lookup
+    if (m_locked)
+        return false;
+
     QWidget *sourceWidget = qobject_cast<QWidget *>(watched);
     if (!sourceWidget)
         return false;
@@ -631,12 +748,21 @@ bool ToolBar::Private::eventFilter(QObject *watched, QEvent *event)
                 auto *data = new ToolbarActionMimeData;
                 data->action = sourceAction;
                 drag->setMimeData(data);
+                auto *mw = mainWindow(q);
+                ScopedTraceSpan span(ToolBarContainerLayout::tracer(q), "actionDrag", "customization", q);
+                mw->d->beginActionsUndoStep();
+                mw->d->addToActionsUndoStep(q);
+                m_isDraggingAction = true;
                 const Qt::DropAction dropAction = drag->exec(Qt::MoveAction | Qt::CopyAction);
+                m_isDraggingAction = false;
                 if (dropAction == Qt::IgnoreAction) {
                     // Action was dropped outside a toolbar, delete it
                     q->removeAction(sourceAction);
                     emit q->actionsCustomized();
                 }
+                mw->d->endActionsUndoStep(dropAction == Qt::IgnoreAction ? tr("Remove Action")
+                                              : dropAction == Qt::CopyAction ? tr("Copy Action")
+                                                                             : tr("Move Action"));
             }
             return true;
         }
@@ -681,11 +807,11 @@ ToolBar::Private::ActionWidget ToolBar::Private::createWidgetForAction(QAction *
     button->setAutoRaise(true);
     button->setFocusPolicy(Qt::NoFocus);
     button->setIconSize(m_iconSize);
-    QObject::connect(q, &ToolBar::iconSizeChanged, button, &QToolButton::setIconSize);
+    auto iconSizeConnection = QObject::connect(q, &ToolBar::iconSizeChanged, button, &QToolButton::setIconSize);
     button->setToolButtonStyle(m_toolButtonStyle);
-    QObject::connect(q, &ToolBar::toolButtonStyleChanged, button, &QToolButton::setToolButtonStyle);
+    auto styleConnection = QObject::connect(q, &ToolBar::toolButtonStyleChanged, button, &QToolButton::setToolButtonStyle);
     button->setDefaultAction(action);
-    return { ToolBarLayout::ToolBarWidgetType::StandardButton, button };
+    return { ToolBarLayout::ToolBarWidgetType::StandardButton, button, { std::move(iconSizeConnection), std::move(styleConnection) } };
 }
 
 ToolBarState ToolBar::Private::state() const
@@ -701,33 +827,157 @@ ToolBarState ToolBar::Private::state() const
         item.objectName = action->objectName();
         return item;
     });
-    state.layoutState = m_layout->state();
+    state.layoutState = m_pendingLayoutState ? *m_pendingLayoutState : m_layout->state();
     return state;
 }
 
-void ToolBar::Private::applyState(const ToolBarState &state, const std::vector<QAction *> &actions)
+int ToolBar::Private::applyState(const ToolBarState &state, const ToolBarStateIndex &index)
+{
+    std::vector<QAction *> actions;
+    actions.reserve(state.actions.size());
+    for (const auto &actionState : state.actions)
+        actions.push_back(actionState.isSeparator ? nullptr : index.actions.value(actionState.objectName));
+    return applyActions(state, actions);
+}
+
+void ToolBar::Private::deferState(const ToolBarState &state, const ToolBarStateIndex &index)
+{
+    m_deferActionWidgets = true;
+    applyState(state, index);
+}
+
+void ToolBar::Private::createDeferredActionWidgets()
+{
+    if (!m_deferActionWidgets)
+        return;
+    m_deferActionWidgets = false;
+
+    // the widgets that already exist are in the order of their actions
+    const auto actions = q->actions();
+    for (int i = 0; i < actions.size(); ++i) {
+        auto *action = actions[i];
+        if (m_actionWidgets.find(action) != m_actionWidgets.end())
+            continue;
+        const auto item = createWidgetForAction(action);
+        m_layout->insertWidget(i, item.widget, item.type);
+        m_actionWidgets[action] = item;
+    }
+
+    if (m_pendingLayoutState) {
+        m_layout->applyState(*m_pendingLayoutState);
+        m_pendingLayoutState.reset();
+    }
+}
+
+void ToolBar::Private::addMemoryUsage(ToolBarMemoryUsage &usage, IconPixmapKeys &pixmapKeys) const
+{
+    usage.childWidgetCount += static_cast<int>(q->findChildren<QWidget *>(QString(), Qt::FindDirectChildrenOnly).size());
+    usage.connectionCount += connectedCount(m_connections);
+
+    const auto devicePixelRatio = q->devicePixelRatioF();
+    for (const auto &item : m_actionWidgets) {
+        if (item.second.type != ToolBarLayout::StandardButton)
+            continue;
+        usage.connectionCount += connectedCount(item.second.connections);
+        const auto *button = static_cast<const QToolButton *>(item.second.widget);
+        if (button->toolButtonStyle() != Qt::ToolButtonTextOnly)
+            usage.pixmapBytes += iconPixmapBytes(button->icon(), button->iconSize(), devicePixelRatio, pixmapKeys);
+    }
+    usage.pixmapBytes += iconPixmapBytes(m_closeButton->icon(), m_closeButton->iconSize(), devicePixelRatio, pixmapKeys);
+
+    usage.dynamicLayoutCount += m_layout->dynamicLayoutCount();
+    usage.dynamicLayoutBytes += m_layout->dynamicLayoutBytes();
+
+    if (m_pendingLayoutState)
+        usage.stateBytes += heapBytes(*m_pendingLayoutState);
+}
+
+int ToolBar::Private::applyActions(const ToolBarState &state, const std::vector<QAction *> &actions)
 {
-    // remove all current actions
     const auto currentActions = q->actions();
-    for (auto *action : currentActions)
-        q->removeAction(action);
 
-    // add back actions
-    for (const auto &actionState : state.actions) {
-        if (actionState.isSeparator) {
-            q->addSeparator();
-        } else {
-            const auto &objectName = actionState.objectName;
-            auto it = std::find_if(actions.begin(), actions.end(), [&objectName](const auto *action) {
-                return action->objectName() == objectName;
+    // actions we want to end up with, separators are reused in order and nullptr stands for a
+    // separator that needs to be created
+    std::vector<QAction *> targetActions;
+    targetActions.reserve(state.actions.size());
+    {
+        auto separatorIt = currentActions.begin();
+        const auto nextSeparator = [&separatorIt, &currentActions]() -> QAction * {
+            separatorIt = std::find_if(separatorIt, currentActions.end(), [](const QAction *action) {
+                return action->isSeparator();
             });
-            if (it != actions.end())
-                q->addAction(*it);
+            return separatorIt != currentActions.end() ? *separatorIt++ : nullptr;
+        };
+        QSet<QAction *> added;
+        for (size_t i = 0; i < state.actions.size(); ++i) {
+            if (state.actions[i].isSeparator) {
+                targetActions.push_back(nextSeparator());
+            } else {
+                auto *action = actions[i];
+                if (action != nullptr && !added.contains(action)) {
+                    added.insert(action);
+                    targetActions.push_back(action);
+                }
+            }
         }
     }
 
-    // restore layout state
-    m_layout->applyState(state.layoutState);
+    std::unordered_map<QAction *, int> targetIndex;
+    for (int i = 0; i < static_cast<int>(targetActions.size()); ++i) {
+        if (auto *action = targetActions[i])
+            targetIndex[action] = i;
+    }
+
+    int changes = 0;
+
+    // remove actions that aren't part of the state, and find the position in the state of the ones
+    // that are
+    std::vector<int> keptIndices;
+    for (auto *action : currentActions) {
+        auto it = targetIndex.find(action);
+        if (it == targetIndex.end()) {
+            q->removeAction(action);
+            ++changes;
+        } else {
+            keptIndices.push_back(it->second);
+        }
+    }
+
+    // the longest run of actions that are already in order stays in place, everything else is
+    // moved or inserted in front of its successor, going backwards
+    std::vector<bool> inPlace(targetActions.size(), false);
+    {
+        const auto mask = longestIncreasingSubsequence(keptIndices);
+        for (size_t i = 0; i < keptIndices.size(); ++i) {
+            if (mask[i])
+                inPlace[keptIndices[i]] = true;
+        }
+    }
+    m_stashActionWidgets = true;
+    QAction *before = nullptr;
+    for (int i = static_cast<int>(targetActions.size()) - 1; i >= 0; --i) {
+        auto *action = targetActions[i];
+        if (action == nullptr) {
+            action = new QAction(q);
+            action->setSeparator(true);
+            targetActions[i] = action;
+        }
+        if (!inPlace[i]) {
+            q->insertAction(before, action);
+            ++changes;
+        }
+        before = action;
+    }
+    m_stashActionWidgets = false;
+    Q_ASSERT(m_stashedActionWidgets.empty());
+
+    // restore layout state, toolbars without their widgets yet apply it once they're created
+    if (m_deferActionWidgets)
+        m_pendingLayoutState = state.layoutState;
+    else
+        m_layout->applyState(state.layoutState);
+
+    return changes;
 }
 
 ToolBar::ToolBar(ToolBarOptions options, QWidget *parent)
@@ -779,7 +1029,7 @@ void ToolBar::paintEvent(QPaintEvent *event)
         p.setFont(f);
 
         style->drawControl(QStyle::CE_DockWidgetTitle, &opt, &p, this);
-    } else {
+    } else if (!d->m_locked) {
         // paint handle
         QStyleOption opt;
         opt.initFrom(this);
@@ -797,6 +1047,12 @@ void ToolBar::actionEvent(QActionEvent *event)
 
 bool ToolBar::event(QEvent *event)
 {
+    if (event->type() == QEvent::Show)
+        d->createDeferredActionWidgets();
+
+    if (d->m_locked)
+        return QFrame::event(event);
+
     switch (event->type()) {
     case QEvent::MouseButtonPress: {
         const auto *me = static_cast<QMouseEvent *>(event);
@@ -972,6 +1228,14 @@ QToolButton *ToolBar::closeButton() const
     return d->m_closeButton;
 }
 
+ToolBarMemoryUsage ToolBar::memoryUsage() const
+{
+    ToolBarMemoryUsage usage;
+    IconPixmapKeys pixmapKeys;
+    d->addMemoryUsage(usage, pixmapKeys);
+    return usage;
+}
+
 bool ToolBar::canDragAction(QAction *) const
 {
     return d->m_options & ToolBarOption::IsCustomizable;
@@ -984,11 +1248,14 @@ bool ToolBar::canDropAction(QAction *) const
 
 bool ToolBar::canBeReset() const
 {
-    return false;
+    auto *mw = mainWindow(this);
+    return mw != nullptr && mw->d->canResetToolBar(this);
 }
 
 void ToolBar::reset()
 {
+    if (auto *mw = mainWindow(this))
+        mw->d->resetToolBar(this);
 }
 
 void ToolBar::updateIconSize(QSize size)
@@ -1007,21 +1274,60 @@ void ToolBar::updateToolButtonStyle(Qt::ToolButtonStyle style)
     d->m_explicitToolButtonStyle = false;
 }
 
-void ToolBarState::save(QDataStream &stream) const
+void ToolBarState::save(StateWriter &writer) const
 {
-    stream << static_cast<int>(actions.size());
+    writer.writeUInt(static_cast<quint32>(actions.size()));
     for (const auto &action : actions) {
-        stream << action.isSeparator;
-        stream << action.objectName;
+        writer.writeBool(action.isSeparator);
+        if (!action.isSeparator)
+            writer.writeString(action.objectName);
+    }
+    layoutState.save(writer);
+}
+
+void ToolBarStateIndex::addToolBars(const std::vector<ToolBar *> &allToolBars)
+{
+    for (auto *toolbar : allToolBars) {
+        if (toolbar->options() & ToolBarOption::IsCustom) {
+            customToolbars.insert(toolbar->windowTitle(), toolbar);
+            continue;
+        }
+        const auto objectName = toolbar->objectName();
+        if (objectName.isEmpty())
+            continue;
+        if (toolbars.contains(objectName)) {
+            qWarning("ToolBarStateIndex: Duplicate toolbar object name %s", qPrintable(objectName));
+            continue;
+        }
+        toolbars.insert(objectName, toolbar);
     }
-    layoutState.save(stream);
+}
+
+bool ToolBarState::load(StateReader &reader)
+{
+    actions.clear();
+    int actionCount;
+    if (!reader.readCount(actionCount))
+        return false;
+    actions.reserve(actionCount);
+    for (int i = 0; i < actionCount; ++i) {
+        Action action;
+        if (!reader.readBool(action.isSeparator))
+            return false;
+        if (!action.isSeparator && !reader.readString(action.objectName))
+            return false;
+        actions.push_back(std::move(action));
+    }
+    return layoutState.load(reader);
 }
 
 bool ToolBarState::load(QDataStream &stream)
 {
     actions.clear();
     int actionCount;
-    stream >> actionCount;
+    // bool and an empty string
+    if (!readCount(stream, actionCount, 5))
+        return false;
     actions.reserve(actionCount);
     for (int i = 0; i < actionCount; ++i) {
         Action action;
@@ -1029,7 +1335,8 @@ bool ToolBarState::load(QDataStream &stream)
         stream >> action.objectName;
         actions.push_back(std::move(action));
     }
-    layoutState.load(stream);
+    if (!layoutState.load(stream))
+        return false;
     return stream.status() == QDataStream::Ok;
 }
 
@@ -68,6 +68,9 @@ public:
 
     QToolButton *closeButton() const;
 
+    // Memory held by this toolbar, its state is only counted while it waits to be applied
+    ToolBarMemoryUsage memoryUsage() const;
+
     virtual bool canDragAction(QAction *action) const;
     virtual bool canDropAction(QAction *action) const;
 
@@ -99,6 +102,7 @@ protected:
     Private *d;
 
     friend class ToolBarTrayLayout;
+    friend class ToolBarContainerLayout;
     friend class MainWindow;
 };
 
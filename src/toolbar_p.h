@@ -12,9 +12,14 @@
 
 #include "toolbar.h"
 #include "toolbarlayout.h"
+#include "toolbarmemoryusage_p.h"
 
+#include <QHash>
 #include <QMimeData>
+#include <QPointer>
 
+#include <array>
+#include <optional>
 #include <unordered_map>
 
 namespace KDToolBars {
@@ -31,10 +36,23 @@ struct ToolBarState
     std::vector<Action> actions;
     ToolBarLayoutState layoutState;
 
-    void save(QDataStream &stream) const;
+    void save(StateWriter &writer) const;
+    bool load(StateReader &reader);
+    // v1 format
     bool load(QDataStream &stream);
 };
 
+// lookup of actions and toolbars by object name, built once when restoring a state
+struct ToolBarStateIndex
+{
+    QHash<QString, QAction *> actions;
+    QHash<QString, ToolBar *> toolbars;
+    // custom toolbars are identified by their title
+    QMultiHash<QString, ToolBar *> customToolbars;
+
+    void addToolBars(const std::vector<ToolBar *> &allToolBars);
+};
+
 class ToolbarActionMimeData : public QMimeData
 {
     Q_OBJECT
@@ -62,6 +80,7 @@ public:
     bool resizeStart(QPoint p);
     void resizeEnd();
     void dragMargin(QPoint p);
+    void endDrag();
 
     void actionEvent(QActionEvent *event);
     bool mousePressEvent(const QMouseEvent *me);
@@ -108,6 +127,8 @@ public:
     {
         ToolBarLayout::ToolBarWidgetType type;
         QWidget *widget;
+        // standard buttons follow the icon size and button style of the toolbar
+        std::array<QMetaObject::Connection, 2> connections = {};
     };
     ActionWidget createWidgetForAction(QAction *action);
 
@@ -115,16 +136,39 @@ public:
     bool updateDropIndicatorGeometry(QPoint pos);
     bool canCustomize() const;
 
+    // locked toolbars can't be moved, resized or customized
+    void setLocked(bool locked);
+
     ToolBarState state() const;
-    void applyState(const ToolBarState &state, const std::vector<QAction *> &actions);
+    // only adds, moves and removes the actions that differ, returns the number of widgets touched
+    int applyState(const ToolBarState &state, const ToolBarStateIndex &index);
+    int applyActions(const ToolBarState &state, const std::vector<QAction *> &actions);
+
+    // hidden toolbars get the actions of a state right away, but the widgets for them and the
+    // layout state wait until they're shown
+    void deferState(const ToolBarState &state, const ToolBarStateIndex &index);
+    void createDeferredActionWidgets();
+    void destroyActionWidget(QAction *action, const ActionWidget &item);
+
+    // icons shared with toolbars whose usage was added before are not counted again
+    void addMemoryUsage(ToolBarMemoryUsage &usage, IconPixmapKeys &pixmapKeys) const;
 
     ToolBar *const q;
     ToolBarOptions m_options;
+    quint64 m_id; // unique to the process, custom toolbars can have the same title
     bool m_columnLayout = false;
     ToolBarLayout *m_layout = nullptr;
     QToolButton *m_closeButton = nullptr;
+    std::array<QMetaObject::Connection, 3> m_connections; // made by init()
     std::unordered_map<QAction *, ActionWidget> m_actionWidgets;
+    bool m_deferActionWidgets = false;
+    std::optional<ToolBarLayoutState> m_pendingLayoutState;
+    // while moving actions, the widgets of removed actions are kept to be reused when added back
+    bool m_stashActionWidgets = false;
+    std::unordered_map<QAction *, ActionWidget> m_stashedActionWidgets;
     bool m_isDragging = false;
+    bool m_isDraggingAction = false;
+    bool m_locked = false;
     QPoint m_dragPos;
     QPoint m_initialDragPos;
     Margin m_resizeMargin = Margin::None;
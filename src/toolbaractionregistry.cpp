@@ -0,0 +1,108 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "toolbaractionregistry.h"
+
+#include "toolbarmemoryusage_p.h"
+
+#include <QAction>
+
+using namespace KDToolBars;
+
+ToolBarActionRegistry::ToolBarActionRegistry(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ToolBarActionRegistry::~ToolBarActionRegistry() = default;
+
+bool ToolBarActionRegistry::addAction(QAction *action)
+{
+    if (m_positions.contains(action))
+        return false;
+    m_positions.insert(action, m_actions.size());
+    m_actions.push_back(action);
+    m_actionsByNameDirty = true;
+    m_connections.push_back({
+        connect(action, &QObject::destroyed, this, &ToolBarActionRegistry::removeAction),
+        connect(action, &QObject::objectNameChanged, this, [this] {
+            m_actionsByNameDirty = true;
+        }),
+    });
+    return true;
+}
+
+bool ToolBarActionRegistry::contains(const QAction *action) const
+{
+    return m_positions.contains(action);
+}
+
+QHash<QString, QAction *> ToolBarActionRegistry::actionsByName() const
+{
+    if (m_actionsByNameDirty) {
+        m_actionsByName.clear();
+        m_actionsByName.reserve(m_positions.size());
+        for (auto *action : m_actions) {
+            if (action == nullptr)
+                continue;
+            const auto objectName = action->objectName();
+            if (m_actionsByName.contains(objectName)) {
+                // only the first action with a given name can be restored
+                if (!objectName.isEmpty())
+                    qWarning("ToolBarActionRegistry: Duplicate action object name %s", qPrintable(objectName));
+                continue;
+            }
+            m_actionsByName.insert(objectName, action);
+        }
+        m_actionsByNameDirty = false;
+    }
+    return m_actionsByName;
+}
+
+QAction *ToolBarActionRegistry::action(const QString &objectName) const
+{
+    return actionsByName().value(objectName);
+}
+
+int ToolBarActionRegistry::connectionCount() const
+{
+    int count = 0;
+    for (const auto &connections : m_connections)
+        count += connectedCount(connections);
+    return count;
+}
+
+void ToolBarActionRegistry::removeAction(QObject *action)
+{
+    auto it = m_positions.find(action);
+    if (it == m_positions.end())
+        return;
+    m_actions[it.value()] = nullptr;
+    m_connections[it.value()] = {};
+    m_positions.erase(it);
+    m_actionsByNameDirty = true;
+    if (m_actions.size() > 2 * static_cast<size_t>(m_positions.size()))
+        compact();
+}
+
+void ToolBarActionRegistry::compact()
+{
+    size_t count = 0;
+    for (size_t i = 0; i < m_actions.size(); ++i) {
+        if (m_actions[i] == nullptr)
+            continue;
+        m_actions[count] = m_actions[i];
+        m_connections[count] = std::move(m_connections[i]);
+        m_positions[m_actions[count]] = count;
+        ++count;
+    }
+    m_actions.resize(count);
+    m_connections.resize(count);
+}
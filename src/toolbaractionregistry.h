@@ -0,0 +1,61 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QObject>
+
+#include <array>
+#include <vector>
+
+class QAction;
+
+namespace KDToolBars {
+
+// All the actions that were ever added to a toolbar of a main window, needed to put back actions
+// that were removed during customization when restoring a state. Actions are removed automatically
+// when destroyed.
+class ToolBarActionRegistry : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ToolBarActionRegistry(QObject *parent = nullptr);
+    ~ToolBarActionRegistry() override;
+
+    // returns false if the action was already registered
+    bool addAction(QAction *action);
+    bool contains(const QAction *action) const;
+    int count() const
+    {
+        return static_cast<int>(m_positions.size());
+    }
+
+    // actions by object name, the first registered one wins if a name is used more than once;
+    // rebuilt lazily, so restoring a state takes a shared copy in constant time
+    QHash<QString, QAction *> actionsByName() const;
+    QAction *action(const QString &objectName) const;
+
+    // connections to the registered actions that are still connected
+    int connectionCount() const;
+
+private:
+    void removeAction(QObject *action);
+    void compact();
+
+    // registration order, with nullptr for destroyed actions
+    std::vector<QAction *> m_actions;
+    std::vector<std::array<QMetaObject::Connection, 2>> m_connections; // of the actions in m_actions
+    QHash<const QObject *, size_t> m_positions;
+    mutable QHash<QString, QAction *> m_actionsByName;
+    mutable bool m_actionsByNameDirty = false;
+};
+
+} // namespace KDToolBars
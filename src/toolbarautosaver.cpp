@@ -0,0 +1,120 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "toolbarautosaver.h"
+
+#include "toolbarcontainerlayout.h"
+#include "toolbarmemoryusage_p.h"
+
+#include <QDataStream>
+#include <QRunnable>
+#include <QSaveFile>
+
+using namespace KDToolBars;
+
+namespace {
+constexpr int kDefaultAutoSaveDelay = 1000;
+
+bool writeState(const QString &fileName, const ToolBarContainerLayout::TrayStates &trayStates)
+{
+    QByteArray data;
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        ToolBarContainerLayout::encodeState(trayStates, stream);
+    }
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning("ToolBarAutoSaver: Failed to write %s: %s", qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+ToolBarAutoSaver::ToolBarAutoSaver(ToolBarContainerLayout *layout, QObject *parent)
+    : QObject(parent)
+    , m_layout(layout)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(kDefaultAutoSaveDelay);
+    m_connections[0] = connect(&m_timer, &QTimer::timeout, this, &ToolBarAutoSaver::save);
+    m_connections[1] = connect(m_layout, &ToolBarContainerLayout::stateChanged, this, &ToolBarAutoSaver::scheduleSave);
+
+    // a single worker, so that writes happen in order
+    m_threadPool.setMaxThreadCount(1);
+}
+
+ToolBarAutoSaver::~ToolBarAutoSaver()
+{
+    flush();
+}
+
+void ToolBarAutoSaver::setFileName(const QString &fileName)
+{
+    flush();
+    m_fileName = fileName;
+}
+
+void ToolBarAutoSaver::setDelay(int msec)
+{
+    m_timer.setInterval(msec);
+}
+
+void ToolBarAutoSaver::scheduleSave()
+{
+    if (m_fileName.isEmpty())
+        return;
+    m_timer.start();
+}
+
+void ToolBarAutoSaver::flush()
+{
+    m_threadPool.waitForDone();
+    m_writing = false;
+    if (m_timer.isActive() || m_changedWhileWriting) {
+        m_timer.stop();
+        m_changedWhileWriting = false;
+        if (!m_fileName.isEmpty())
+            writeState(m_fileName, m_layout->state());
+    }
+}
+
+int ToolBarAutoSaver::connectionCount() const
+{
+    return connectedCount(m_connections);
+}
+
+void ToolBarAutoSaver::save()
+{
+    if (m_fileName.isEmpty())
+        return;
+    if (m_writing) {
+        m_changedWhileWriting = true;
+        return;
+    }
+
+    m_writing = true;
+    auto *runnable = QRunnable::create([this, fileName = m_fileName, trayStates = m_layout->state()] {
+        writeState(fileName, trayStates);
+        QMetaObject::invokeMethod(this, [this] { writeFinished(); }, Qt::QueuedConnection);
+    });
+    m_threadPool.start(runnable);
+}
+
+void ToolBarAutoSaver::writeFinished()
+{
+    if (!m_writing)
+        return; // already waited for in flush()
+    m_writing = false;
+    if (m_changedWhileWriting) {
+        m_changedWhileWriting = false;
+        save();
+    }
+}
@@ -0,0 +1,64 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <array>
+
+namespace KDToolBars {
+
+class ToolBarContainerLayout;
+
+// Saves the toolbar state to a file some time after it last changed. The state is captured on the
+// GUI thread, then serialized and written on a worker thread; changes made while a write is in
+// flight are coalesced into a single write once it's done.
+class ToolBarAutoSaver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ToolBarAutoSaver(ToolBarContainerLayout *layout, QObject *parent = nullptr);
+    ~ToolBarAutoSaver() override;
+
+    void setFileName(const QString &fileName);
+    QString fileName() const
+    {
+        return m_fileName;
+    }
+
+    void setDelay(int msec);
+    int delay() const
+    {
+        return m_timer.interval();
+    }
+
+    void scheduleSave();
+    // writes any pending change synchronously
+    void flush();
+
+    int connectionCount() const;
+
+private:
+    void save();
+    void writeFinished();
+
+    ToolBarContainerLayout *m_layout;
+    QString m_fileName;
+    QTimer m_timer;
+    std::array<QMetaObject::Connection, 2> m_connections;
+    QThreadPool m_threadPool;
+    bool m_writing = false;
+    bool m_changedWhileWriting = false;
+};
+
+} // namespace KDToolBars
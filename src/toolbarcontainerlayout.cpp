@@ -11,6 +11,12 @@
 #include "toolbarcontainerlayout.h"
 
 #include "toolbar.h"
+#include "toolbar_p.h"
+#include "toolbaractionregistry.h"
+#include "toolbarperformancecounters_p.h"
+#include "toolbarstatecodec.h"
+#include "toolbartracer.h"
+#include "tracehooks_p.h"
 #include "toolbartraylayout.h"
 
 #include <QAction>
@@ -23,12 +29,112 @@
 using namespace KDToolBars;
 
 namespace {
-constexpr int kLayoutVersionMarker = 1;
+constexpr int kLayoutVersionMarkerV1 = 1;
+constexpr int kLayoutVersionMarker = 2;
+
+struct ItemStateLocation
+{
+    size_t tray;
+    size_t row;
+    size_t index;
+};
+
+// custom toolbars are identified by their title
+bool isItemStateOf(const ToolBarTrayLayoutState::Item &item, const ToolBar *toolbar)
+{
+    const bool isCustom = toolbar->options() & ToolBarOption::IsCustom;
+    return item.isCustom == isCustom && item.objectName == (isCustom ? toolbar->windowTitle() : toolbar->objectName());
+}
+
+std::optional<ItemStateLocation> findItemState(const ToolBarContainerLayout::TrayStates &trayStates, const ToolBar *toolbar)
+{
+    for (size_t tray = 0; tray < trayStates.size(); ++tray) {
+        const auto &rows = trayStates[tray].rows;
+        for (size_t row = 0; row < rows.size(); ++row) {
+            const auto &items = rows[row].items;
+            for (size_t index = 0; index < items.size(); ++index) {
+                if (isItemStateOf(items[index], toolbar))
+                    return ItemStateLocation { tray, row, index };
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+const ToolBarTrayLayoutState::Item &itemState(const ToolBarContainerLayout::TrayStates &trayStates, ItemStateLocation location)
+{
+    return trayStates[location.tray].rows[location.row].items[location.index];
+}
+
+void removeItemState(ToolBarContainerLayout::TrayStates &trayStates, ItemStateLocation location)
+{
+    auto &rows = trayStates[location.tray].rows;
+    auto &items = rows[location.row].items;
+    items.erase(items.begin() + location.index);
+    if (items.empty())
+        rows.erase(rows.begin() + location.row);
+}
+
+// inserts an item at its position in the given row, or in a new last row if there's no such row
+void insertItemState(ToolBarContainerLayout::TrayStates &trayStates, ItemStateLocation location, const ToolBarTrayLayoutState::Item &item)
+{
+    auto &rows = trayStates[location.tray].rows;
+    if (location.row >= rows.size()) {
+        rows.emplace_back();
+        location.row = rows.size() - 1;
+    }
+    auto &items = rows[location.row].items;
+    auto it = std::upper_bound(items.begin(), items.end(), item.pos, [](int pos, const auto &other) {
+        return pos < other.pos;
+    });
+    items.insert(it, item);
+}
+
+// index of the row of a tray holding any of the toolbars of another row
+std::optional<size_t> findRowSharingItems(const ToolBarTrayLayoutState &trayState, const ToolBarTrayLayoutState::Row &row)
+{
+    const auto isInRow = [&row](const ToolBarTrayLayoutState::Item &item) {
+        return std::any_of(row.items.begin(), row.items.end(), [&item](const auto &other) {
+            return other.isCustom == item.isCustom && other.objectName == item.objectName;
+        });
+    };
+    for (size_t i = 0; i < trayState.rows.size(); ++i) {
+        const auto &items = trayState.rows[i].items;
+        if (std::any_of(items.begin(), items.end(), isInRow))
+            return i;
+    }
+    return std::nullopt;
+}
+
+// inserts an item in the row holding the toolbars it shares its default row with, or else in a new
+// row below the toolbars of the default rows above it; row indices of the default state don't
+// match the current rows once toolbars were moved
+void insertDefaultItemState(ToolBarContainerLayout::TrayStates &trayStates, const ToolBarContainerLayout::TrayStates &defaultState,
+                            ItemStateLocation defaultLocation)
+{
+    const auto &item = itemState(defaultState, defaultLocation);
+    const auto &defaultRows = defaultState[defaultLocation.tray].rows;
+    auto &trayState = trayStates[defaultLocation.tray];
+    if (const auto row = findRowSharingItems(trayState, defaultRows[defaultLocation.row])) {
+        insertItemState(trayStates, { defaultLocation.tray, *row, 0 }, item);
+        return;
+    }
+    size_t newRow = 0;
+    for (size_t i = defaultLocation.row; i-- > 0;) {
+        if (const auto row = findRowSharingItems(trayState, defaultRows[i])) {
+            newRow = *row + 1;
+            break;
+        }
+    }
+    ToolBarTrayLayoutState::Row row;
+    row.items.push_back(item);
+    trayState.rows.insert(trayState.rows.begin() + newRow, std::move(row));
+}
 }
 
 ToolBarContainerLayout::ToolBarContainerLayout(QWidget *parent)
     : QLayout(parent)
-    , m_actionContainer(new QWidget)
+    , m_actionRegistry(new ToolBarActionRegistry(this))
 {
     m_trays[TopTray] = new ToolBarTrayLayout(ToolBarTray::Top, Qt::Horizontal, this);
     m_trays[LeftTray] = new ToolBarTrayLayout(ToolBarTray::Left, Qt::Vertical, this);
@@ -42,6 +148,55 @@ ToolBarContainerLayout::~ToolBarContainerLayout()
     qDeleteAll(m_trays);
 }
 
+ToolBarContainerLayout *ToolBarContainerLayout::containerLayout(const ToolBar *toolbar)
+{
+    // docked and floating toolbars are both children of the container widget
+    auto *parent = toolbar->parentWidget();
+    return parent != nullptr ? qobject_cast<ToolBarContainerLayout *>(parent->layout()) : nullptr;
+}
+
+ToolBarPerformanceCounters *ToolBarContainerLayout::performanceCounters(const ToolBar *toolbar)
+{
+    auto *container = containerLayout(toolbar);
+    return container != nullptr ? container->performanceCounters() : nullptr;
+}
+
+void ToolBarContainerLayout::startTracing()
+{
+    m_tracer = std::make_shared<ToolBarTracer>();
+}
+
+std::shared_ptr<ToolBarTracer> ToolBarContainerLayout::stopTracing()
+{
+    return std::move(m_tracer);
+}
+
+std::shared_ptr<ToolBarTracer> ToolBarContainerLayout::tracer(const ToolBar *toolbar)
+{
+    auto *container = containerLayout(toolbar);
+    return container != nullptr ? container->tracer() : nullptr;
+}
+
+void ToolBarContainerLayout::notifyStateChanged(const ToolBar *toolbar)
+{
+    if (auto *container = containerLayout(toolbar))
+        emit container->stateChanged();
+}
+
+ToolBarContainerLayout::DragState ToolBarContainerLayout::dragState() const
+{
+    for (const auto *toolbar : m_toolbars) {
+        const auto *d = toolbar->d;
+        if (d->m_isDraggingAction)
+            return DragState::DraggingAction;
+        if (d->isResizing())
+            return DragState::ResizingToolBar;
+        if (d->m_isDragging)
+            return toolbar->isFloating() ? DragState::MovingFloatingToolBar : DragState::MovingDockedToolBar;
+    }
+    return DragState::Idle;
+}
+
 void ToolBarContainerLayout::addItem(QLayoutItem *)
 {
     qWarning("ToolBarTrayContainerLayout::addItem: Please use addToolBar instead");
@@ -95,58 +250,127 @@ Qt::Orientations ToolBarContainerLayout::expandingDirections() const
 
 void ToolBarContainerLayout::setGeometry(const QRect &rect)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBarContainerLayout::setGeometry");
+    ScopedPerformanceCounter counter(&m_performanceCounters, &ToolBarPerformanceCounters::layoutPasses);
+    ScopedTraceSpan span(m_tracer, "layout", "layout");
+
     QLayout::setGeometry(rect);
 
-    auto contentsRect = this->contentsRect();
+    const auto &result = layoutResult(contentsRect());
+
+    for (size_t i = 0; i < TrayCount; ++i) {
+        m_trays[i]->setGeometry(result.trayRects[i]);
+        ScopedPerformanceCounter geometryCounter(&m_performanceCounters, &ToolBarPerformanceCounters::widgetGeometryUpdates,
+                                         result.trayGeometries[i].size());
+        ToolBarTrayLayout::applyGeometries(result.trayGeometries[i]);
+    }
+
+    if (m_centralWidgetLayoutItem != nullptr)
+        m_centralWidgetLayoutItem->setGeometry(result.centralWidgetRect);
+}
+
+const ToolBarContainerLayout::LayoutResult &ToolBarContainerLayout::layoutResult(const QRect &contentsRect)
+{
+    KDTOOLBARS_TRACE_SCOPE("ToolBarContainerLayout::layoutResult");
+    auto it = std::find_if(m_layoutResults.begin(), m_layoutResults.end(), [&contentsRect](const LayoutResult &result) {
+        return result.contentsRect == contentsRect;
+    });
+    if (it != m_layoutResults.end()) {
+        std::rotate(m_layoutResults.begin(), it, it + 1);
+        return m_layoutResults.front();
+    }
+
+    // the extent of the trays is only known at this point, needed if toolbar rows are packed
+    topTray()->setAvailableExtent(contentsRect.width());
+    bottomTray()->setAvailableExtent(contentsRect.width());
 
     const auto topHeight = topTray()->sizeHint().height();
     const auto bottomHeight = bottomTray()->sizeHint().height();
+    const auto centerHeight = contentsRect.height() - (topHeight + bottomHeight);
+
+    leftTray()->setAvailableExtent(centerHeight);
+    rightTray()->setAvailableExtent(centerHeight);
 
     const auto leftWidth = leftTray()->sizeHint().width();
     const auto rightWidth = rightTray()->sizeHint().width();
-
     const auto centerWidth = contentsRect.width() - (leftWidth + rightWidth);
-    const auto centerHeight = contentsRect.height() - (topHeight + bottomHeight);
+
+    LayoutResult result;
+    result.contentsRect = contentsRect;
 
     // top tray
-    auto topRect = contentsRect;
+    auto &topRect = result.trayRects[TopTray];
+    topRect = contentsRect;
     topRect.setHeight(topHeight);
-    topTray()->setGeometry(topRect);
 
     // left tray
-    auto leftRect = contentsRect;
+    auto &leftRect = result.trayRects[LeftTray];
+    leftRect = contentsRect;
     leftRect.setTop(contentsRect.top() + topHeight);
     leftRect.setWidth(leftWidth);
     leftRect.setHeight(centerHeight);
-    leftTray()->setGeometry(leftRect);
 
     // right tray
-    auto rightRect = contentsRect;
+    auto &rightRect = result.trayRects[RightTray];
+    rightRect = contentsRect;
     rightRect.setLeft(contentsRect.left() + contentsRect.width() - rightWidth);
     rightRect.setTop(contentsRect.top() + topHeight);
     rightRect.setHeight(centerHeight);
-    rightTray()->setGeometry(rightRect);
 
     // bottom tray
-    auto bottomRect = contentsRect;
+    auto &bottomRect = result.trayRects[BottomTray];
+    bottomRect = contentsRect;
     bottomRect.setTop(contentsRect.top() + topHeight + centerHeight);
-    bottomTray()->setGeometry(bottomRect);
 
-    if (m_centralWidgetLayoutItem != nullptr) {
-        const auto pos = contentsRect.topLeft() + QPoint(leftWidth, topHeight);
-        const auto size = QSize(centerWidth, centerHeight);
-        m_centralWidgetLayoutItem->setGeometry(QRect(pos, size));
+    for (size_t i = 0; i < TrayCount; ++i) {
+        m_trays[i]->setGeometry(result.trayRects[i]);
+        result.trayGeometries[i] = m_trays[i]->computeGeometries();
     }
+
+    const auto pos = contentsRect.topLeft() + QPoint(leftWidth, topHeight);
+    result.centralWidgetRect = QRect(pos, QSize(centerWidth, centerHeight));
+
+    if (m_layoutResults.size() == kMaxCachedLayoutResults)
+        m_layoutResults.pop_back();
+    m_layoutResults.insert(m_layoutResults.begin(), std::move(result));
+    return m_layoutResults.front();
 }
 
 QSize ToolBarContainerLayout::sizeHint() const
 {
-    return layoutSize(&ToolBarTrayLayout::sizeHint, &QLayoutItem::sizeHint);
+    KDTOOLBARS_TRACE_SCOPE("ToolBarContainerLayout::sizeHint");
+    updateSizeCache();
+    return m_sizeCache->sizeHint;
 }
 
 QSize ToolBarContainerLayout::minimumSize() const
 {
-    return layoutSize(&ToolBarTrayLayout::minimumSize, &QLayoutItem::minimumSize);
+    KDTOOLBARS_TRACE_SCOPE("ToolBarContainerLayout::minimumSize");
+    updateSizeCache();
+    return m_sizeCache->minimumSize;
+}
+
+void ToolBarContainerLayout::updateSizeCache() const
+{
+    if (m_sizeCache) {
+        bool valid = true;
+        for (size_t i = 0; i < TrayCount; ++i) {
+            const auto *tray = m_trays[i];
+            if (tray->isDirty() || tray->sizeGeneration() != m_sizeCache->traySizeGenerations[i]) {
+                valid = false;
+                break;
+            }
+        }
+        if (valid)
+            return;
+    }
+
+    SizeCache cache;
+    cache.sizeHint = layoutSize(&ToolBarTrayLayout::sizeHint, &QLayoutItem::sizeHint);
+    cache.minimumSize = layoutSize(&ToolBarTrayLayout::minimumSize, &QLayoutItem::minimumSize);
+    for (size_t i = 0; i < TrayCount; ++i)
+        cache.traySizeGenerations[i] = m_trays[i]->sizeGeneration();
+    m_sizeCache = cache;
 }
 
 template<typename TraySizeGetterT, typename WidgetSizeGetterT>
@@ -171,9 +395,41 @@ void ToolBarContainerLayout::invalidate()
 {
     for (auto &tray : m_trays)
         tray->invalidate();
+    m_sizeCache.reset();
+    m_layoutResults.clear();
     QLayout::invalidate();
 }
 
+void ToolBarContainerLayout::setRowPackingEnabled(bool enabled)
+{
+    if (enabled == m_rowPacking)
+        return;
+    m_rowPacking = enabled;
+    for (auto *tray : m_trays)
+        tray->setRowPackingEnabled(enabled);
+    invalidate();
+}
+
+bool ToolBarContainerLayout::isRowPackingEnabled() const
+{
+    return m_rowPacking;
+}
+
+void ToolBarContainerLayout::setLocked(bool locked)
+{
+    if (locked == m_locked)
+        return;
+    m_locked = locked;
+    for (auto *toolbar : m_toolbars)
+        toolbar->d->setLocked(locked);
+    invalidate();
+}
+
+bool ToolBarContainerLayout::isLocked() const
+{
+    return m_locked;
+}
+
 void ToolBarContainerLayout::setCentralWidget(QWidget *widget)
 {
     if (m_centralWidgetLayoutItem != nullptr) {
@@ -218,22 +474,21 @@ void ToolBarContainerLayout::insertToolBar(ToolBarTrayLayout *trayLayout, ToolBa
     m_toolbars.push_back(toolbar);
     m_toolbarTray[toolbar] = trayLayout;
     trayLayout->insertToolBar(before, toolbar);
+    toolbar->d->setLocked(m_locked);
 
-    // Add all actions in the toolbar to the dummy widget m_actionContainer. We need them for when we restore
-    // the state of the toolbars. We can't simply collect all actions from the existing toolbars immediately
-    // before restoring, because toolbars may have lost some of the actions during customization and we want to
-    // add them back when restoring.
-    //
-    // We use a QWidget for this because if the action is destroyed it's automatically removed from
-    // m_actionContainer.
+    // Register all actions in the toolbar. We need them for when we restore the state of the toolbars.
+    // We can't simply collect all actions from the existing toolbars immediately before restoring,
+    // because toolbars may have lost some of the actions during customization and we want to add them
+    // back when restoring.
     const auto actions = toolbar->actions();
     for (auto *action : actions)
-        m_actionContainer->addAction(action);
+        m_actionRegistry->addAction(action);
     toolbar->installEventFilter(this);
 
     invalidate();
 
     emit toolBarInserted(toolbar);
+    emit stateChanged();
 }
 
 void ToolBarContainerLayout::addToolBarBreak(ToolBarTray tray)
@@ -245,6 +500,7 @@ void ToolBarContainerLayout::addToolBarBreak(ToolBarTray tray)
     m_trays[trayIndex]->insertToolBarBreak(nullptr);
 
     invalidate();
+    emit stateChanged();
 }
 
 void ToolBarContainerLayout::insertToolBarBreak(ToolBar *before)
@@ -254,10 +510,12 @@ void ToolBarContainerLayout::insertToolBarBreak(ToolBar *before)
     trayLayout->insertToolBarBreak(before);
 
     invalidate();
+    emit stateChanged();
 }
 
 void ToolBarContainerLayout::moveToolBar(ToolBar *toolbar, QPoint pos)
 {
+    ScopedTraceSpan span(m_tracer, "moveToolBar", "drag", toolbar);
     auto *tray = toolBarTray(toolbar);
     if (tray == nullptr)
         return;
@@ -276,6 +534,7 @@ void ToolBarContainerLayout::adjustToolBarRow(const ToolBar *toolbar)
 
 void ToolBarContainerLayout::hoverToolBar(ToolBar *toolbar)
 {
+    ScopedTraceSpan span(m_tracer, "hoverToolBar", "drag", toolbar);
     bool docked = false;
     for (auto *tray : m_trays) {
         if (!toolbar->allowedTrays().testFlag(tray->tray()))
@@ -312,8 +571,44 @@ void ToolBarContainerLayout::removeToolBar(ToolBar *toolbar)
     m_toolbars.erase(it);
     m_toolbarTray.erase(toolbar);
     toolbar->removeEventFilter(this);
+    toolbar->d->setLocked(false);
 
     emit toolBarRemoved();
+    emit stateChanged();
+}
+
+void ToolBarContainerLayout::placeToolBars(const QVector<ToolBarPlacement> &placements)
+{
+    // take all the toolbars out of their trays first, so that rows are only indexed after they're
+    // rebuilt
+    std::unordered_map<const ToolBar *, QLayoutItem *> items;
+    for (const auto &placement : placements) {
+        auto *toolbar = placement.toolbar;
+        if (toolbar == nullptr || trayIndex(placement.tray) == -1 || items.count(toolbar) != 0)
+            continue;
+        auto *tray = toolBarTray(toolbar);
+        if (tray == nullptr) {
+            tray = m_trays[trayIndex(placement.tray)];
+            insertToolBar(tray, nullptr, toolbar);
+        }
+        items[toolbar] = tray->takeToolBar(toolbar);
+    }
+
+    for (const auto &placement : placements) {
+        auto it = items.find(placement.toolbar);
+        if (it == items.end())
+            continue; // invalid placement, or toolbar was already placed
+        auto *tray = m_trays[trayIndex(placement.tray)];
+        tray->placeToolBar(it->second, placement);
+        m_toolbarTray[placement.toolbar] = tray;
+        items.erase(it);
+    }
+
+    for (auto *tray : m_trays)
+        tray->removeEmptyRows();
+
+    invalidate();
+    emit stateChanged();
 }
 
 int ToolBarContainerLayout::trayIndex(ToolBarTray tray) const
@@ -335,89 +630,240 @@ int ToolBarContainerLayout::trayIndex(ToolBarTray tray) const
 
 bool ToolBarContainerLayout::eventFilter(QObject *watched, QEvent *event)
 {
-    if (event->type() == QEvent::ActionAdded) {
+    switch (event->type()) {
+    case QEvent::ActionAdded: {
         auto *action = static_cast<QActionEvent *>(event)->action();
-        if (auto *tb = qobject_cast<ToolBar *>(watched))
-            m_actionContainer->addAction(action);
+        if (qobject_cast<ToolBar *>(watched) != nullptr)
+            m_actionRegistry->addAction(action);
+        break;
+    }
+    case QEvent::ShowToParent:
+    case QEvent::HideToParent:
+        // hidden toolbars are saved as such
+        if (qobject_cast<ToolBar *>(watched) != nullptr)
+            emit stateChanged();
+        break;
+    default:
+        break;
     }
 
     return QLayout::eventFilter(watched, event);
 }
 
 void ToolBarContainerLayout::saveState(QDataStream &stream) const
+{
+    encodeState(state(), stream);
+}
+
+ToolBarContainerLayout::TrayStates ToolBarContainerLayout::state() const
+{
+    TrayStates trayStates;
+    for (size_t i = 0; i < TrayCount; ++i)
+        trayStates[i] = m_trays[i]->state();
+    return trayStates;
+}
+
+void ToolBarContainerLayout::encodeState(const TrayStates &trayStates, QDataStream &stream)
 {
     stream << kLayoutVersionMarker;
+    StateWriter writer;
     const auto count = std::accumulate(
-        m_trays.begin(), m_trays.end(), 0,
-        [](int count, const auto &tray) { return count + tray->count(); });
-    stream << count;
-    for (const auto *tray : m_trays)
-        tray->state().save(stream);
+        trayStates.begin(), trayStates.end(), 0, [](int count, const auto &trayState) {
+            return std::accumulate(trayState.rows.begin(), trayState.rows.end(), count, [](int count, const auto &row) {
+                return count + static_cast<int>(row.items.size());
+            });
+        });
+    writer.writeUInt(count);
+    for (const auto &trayState : trayStates)
+        trayState.save(writer);
+    writer.writeTo(stream);
 }
 
 bool ToolBarContainerLayout::restoreState(QDataStream &stream)
 {
-    int version, toolbarCount;
-    stream >> version >> toolbarCount;
-    if (stream.status() != QDataStream::Ok || version != kLayoutVersionMarker)
+    ScopedTraceSpan span(m_tracer, "restoreState", "state");
+    TrayStates trayStates;
+    if (!decodeState(stream, trayStates))
+        return false;
+    applyState(trayStates);
+    return true;
+}
+
+bool ToolBarContainerLayout::decodeState(QDataStream &stream, TrayStates &trayStates)
+{
+    KDTOOLBARS_TRACE_SCOPE("ToolBarContainerLayout::decodeState");
+    static_assert(std::tuple_size_v<TrayStates> == TrayCount);
+
+    int version;
+    stream >> version;
+    if (stream.status() != QDataStream::Ok)
         return false;
 
-    // load tray states
-    std::array<ToolBarTrayLayoutState, TrayCount> trayStates;
-    for (auto &state : trayStates) {
-        if (!state.load(stream))
+    if (version == kLayoutVersionMarker) {
+        StateReader reader(stream);
+        quint32 toolbarCount;
+        if (!reader.readUInt(toolbarCount))
+            return false;
+        for (auto &state : trayStates) {
+            if (!state.load(reader))
+                return false;
+        }
+        if (!reader.atEnd())
             return false;
+    } else if (version == kLayoutVersionMarkerV1) {
+        int toolbarCount;
+        stream >> toolbarCount;
+        for (auto &state : trayStates) {
+            if (!state.load(stream))
+                return false;
+        }
+    } else {
+        return false;
     }
+    return true;
+}
 
-    // all toolbar actions
-    const std::vector<QAction *> actions = [this] {
-        auto actions = m_actionContainer->actions();
-        return std::vector<QAction *>(actions.begin(), actions.end());
-    }();
+void ToolBarContainerLayout::applyState(const TrayStates &trayStates)
+{
+    KDTOOLBARS_TRACE_SCOPE("ToolBarContainerLayout::applyState");
+    ScopedTraceSpan span(m_tracer, "applyState", "state");
 
-    // remove any custom toolbars (will be recreated when we apply state)
+    // all toolbar actions and the toolbars that can be restored, by object name
+    ToolBarStateIndex index;
+    index.actions = m_actionRegistry->actionsByName();
+    index.addToolBars(m_toolbars);
+
+    // clear toolbar tray map, the trays add the toolbars they restore
+    decltype(m_toolbarTray) oldToolbarTray;
+    std::swap(oldToolbarTray, m_toolbarTray);
+
+    m_lastRestoreChanges = 0;
+    for (size_t i = 0; i < TrayCount; ++i)
+        m_lastRestoreChanges += m_trays[i]->applyState(trayStates[i], index);
+
+    // add back any toolbar that wasn't restored, custom toolbars that weren't restored are deleted
     {
         auto it = m_toolbars.begin();
         while (it != m_toolbars.end()) {
             auto *toolbar = *it;
-            if (toolbar->options() & ToolBarOption::IsCustom) {
+            if (m_toolbarTray.find(toolbar) != m_toolbarTray.end()) {
+                ++it;
+            } else if (toolbar->options() & ToolBarOption::IsCustom) {
                 it = m_toolbars.erase(it);
-                m_toolbarTray.erase(toolbar);
                 delete toolbar;
+                ++m_lastRestoreChanges;
             } else {
+                auto *tray = oldToolbarTray[toolbar];
+                tray->insertToolBar(nullptr, toolbar);
+                m_toolbarTray[toolbar] = tray;
                 ++it;
             }
         }
     }
 
-    for (size_t i = 0; i < TrayCount; ++i)
-        m_trays[i]->applyState(trayStates[i], m_toolbars, actions);
+    invalidate();
+    emit stateChanged();
+}
 
-    // clear toolbar tray map
-    decltype(m_toolbarTray) oldToolbarTray;
-    std::swap(oldToolbarTray, m_toolbarTray);
+bool ToolBarContainerLayout::hasToolBarState(const TrayStates &trayStates, const ToolBar *toolbar)
+{
+    return findItemState(trayStates, toolbar).has_value();
+}
 
-    // add back any toolbar that wasn't restored
-    for (auto *toolbar : m_toolbars) {
-        const auto found = std::any_of(
-            m_trays.begin(), m_trays.end(), [toolbar](auto *tray) { return tray->hasToolBar(toolbar); });
-        if (!found) {
-            auto *tray = oldToolbarTray[toolbar];
-            tray->insertToolBar(nullptr, toolbar);
-        }
+void ToolBarContainerLayout::resetToolBar(ToolBar *toolbar, const TrayStates &defaultState)
+{
+    const auto defaultLocation = findItemState(defaultState, toolbar);
+    if (!defaultLocation)
+        return;
+
+    // move the toolbar to its default place, everything else stays as it is
+    auto trayStates = state();
+    if (const auto location = findItemState(trayStates, toolbar))
+        removeItemState(trayStates, *location);
+    insertDefaultItemState(trayStates, defaultState, *defaultLocation);
+    applyState(trayStates);
+}
+
+void ToolBarContainerLayout::resetToolBars(const TrayStates &defaultState)
+{
+    // custom toolbars created since the default state was captured keep their place
+    auto trayStates = defaultState;
+    const auto currentState = state();
+    for (const auto *toolbar : m_toolbars) {
+        if (!(toolbar->options() & ToolBarOption::IsCustom) || hasToolBarState(defaultState, toolbar))
+            continue;
+        if (const auto location = findItemState(currentState, toolbar))
+            insertItemState(trayStates, *location, itemState(currentState, *location));
     }
+    applyState(trayStates);
+}
+
+quint64 ToolBarContainerLayout::toolBarId(const ToolBar *toolbar)
+{
+    return toolbar->d->m_id;
+}
+
+void ToolBarContainerLayout::setToolBarId(ToolBar *toolbar, quint64 id)
+{
+    toolbar->d->m_id = id;
+}
+
+ToolBar *ToolBarContainerLayout::findToolBar(quint64 id) const
+{
+    auto it = std::find_if(m_toolbars.begin(), m_toolbars.end(), [id](const ToolBar *toolbar) {
+        return toolbar->d->m_id == id;
+    });
+    return it != m_toolbars.end() ? *it : nullptr;
+}
+
+ToolBarState ToolBarContainerLayout::toolBarState(const ToolBar *toolbar) const
+{
+    return toolbar->d->state();
+}
+
+int ToolBarContainerLayout::applyToolBarState(ToolBar *toolbar, const ToolBarState &state)
+{
+    ToolBarStateIndex index;
+    index.actions = m_actionRegistry->actionsByName();
+    const auto changes = toolbar->d->applyState(state, index);
+    emit stateChanged();
+    return changes;
+}
 
-    // reinitialize the toolbar -> tray map
-    for (auto *toolbar : m_toolbars) {
-        auto it = std::find_if(
-            m_trays.begin(), m_trays.end(), [toolbar](auto *tray) { return tray->hasToolBar(toolbar); });
-        Q_ASSERT(it != m_trays.end());
-        m_toolbarTray[toolbar] = *it;
+std::optional<ToolBarPlacement> ToolBarContainerLayout::toolBarPlacement(const ToolBar *toolbar) const
+{
+    auto *tray = toolBarTray(toolbar);
+    if (tray == nullptr)
+        return std::nullopt;
+    return tray->placement(toolbar);
+}
+
+void ToolBarContainerLayout::placeToolBarInNewRow(const ToolBarPlacement &placement)
+{
+    auto *toolbar = placement.toolbar;
+    const auto trayIndex = this->trayIndex(placement.tray);
+    if (toolbar == nullptr || trayIndex == -1)
+        return;
+    auto *tray = toolBarTray(toolbar);
+    if (tray == nullptr) {
+        tray = m_trays[trayIndex];
+        insertToolBar(tray, nullptr, toolbar);
     }
+    auto *item = tray->takeToolBar(toolbar);
+    tray->removeEmptyRows();
+
+    tray = m_trays[trayIndex];
+    tray->insertRow(placement.row);
+    tray->placeToolBar(item, placement);
+    m_toolbarTray[toolbar] = tray;
 
     invalidate();
+    emit stateChanged();
+}
 
-    return true;
+int ToolBarContainerLayout::actionRegistryConnectionCount() const
+{
+    return m_actionRegistry->connectionCount();
 }
 
 int ToolBarContainerLayout::toolBarCount() const
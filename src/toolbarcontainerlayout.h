@@ -11,17 +11,20 @@
 #pragma once
 
 #include "mainwindow.h"
+#include "toolbartraylayout.h"
 
 #include <QLayout>
 
 #include <array>
+#include <memory>
 #include <optional>
 #include <unordered_map>
 
 namespace KDToolBars {
 
 class ToolBar;
-class ToolBarTrayLayout;
+class ToolBarActionRegistry;
+class ToolBarTracer;
 
 class ToolBarContainerLayout : public QLayout
 {
@@ -42,11 +45,18 @@ public:
 
     void setCentralWidget(QWidget *widget);
 
+    void setRowPackingEnabled(bool enabled);
+    bool isRowPackingEnabled() const;
+
+    void setLocked(bool locked);
+    bool isLocked() const;
+
     void addToolBar(ToolBarTray tray, ToolBar *toolbar);
     void insertToolBar(ToolBar *before, ToolBar *toolbar);
     void addToolBarBreak(ToolBarTray tray);
     void insertToolBarBreak(ToolBar *before);
     void removeToolBar(ToolBar *toolbar);
+    void placeToolBars(const QVector<ToolBarPlacement> &placements);
 
     void moveToolBar(ToolBar *toolbar, QPoint pos);
     void adjustToolBarRow(const ToolBar *toolbar);
@@ -62,11 +72,74 @@ public:
     void saveState(QDataStream &stream) const;
     bool restoreState(QDataStream &stream);
 
+    // decoding doesn't touch any widget and can run on any thread
+    using TrayStates = std::array<ToolBarTrayLayoutState, 4>;
+    TrayStates state() const;
+    static void encodeState(const TrayStates &trayStates, QDataStream &stream);
+    static bool decodeState(QDataStream &stream, TrayStates &trayStates);
+    void applyState(const TrayStates &trayStates);
+    int lastRestoreChanges() const
+    {
+        return m_lastRestoreChanges;
+    }
+    // connections the action registry keeps to the actions of the toolbars
+    int actionRegistryConnectionCount() const;
+
+    // Resetting applies the default state of one or all toolbars in a single pass, toolbars that
+    // aren't part of the default state keep their current place
+    static bool hasToolBarState(const TrayStates &trayStates, const ToolBar *toolbar);
+    void resetToolBar(ToolBar *toolbar, const TrayStates &defaultState);
+    void resetToolBars(const TrayStates &defaultState);
+
+    // used by undo steps, which only touch the toolbars they changed; they find toolbars by their
+    // id and give the id of a deleted custom toolbar to the one they create again
+    static quint64 toolBarId(const ToolBar *toolbar);
+    static void setToolBarId(ToolBar *toolbar, quint64 id);
+    ToolBar *findToolBar(quint64 id) const;
+    ToolBarState toolBarState(const ToolBar *toolbar) const;
+    int applyToolBarState(ToolBar *toolbar, const ToolBarState &state);
+    std::optional<ToolBarPlacement> toolBarPlacement(const ToolBar *toolbar) const;
+    // like placeToolBars, but in a new row inserted at the row of the placement
+    void placeToolBarInNewRow(const ToolBarPlacement &placement);
+
+    // counters of the layout work of this container, or of the container holding a toolbar,
+    // null if the toolbar isn't in a main window
+    ToolBarPerformanceCounters *performanceCounters() const
+    {
+        return &m_performanceCounters;
+    }
+    static ToolBarPerformanceCounters *performanceCounters(const ToolBar *toolbar);
+
+    // the tracer only exists while tracing, spans that are still open when tracing stops (such as
+    // an action drag running its own event loop) keep it alive until they end
+    void startTracing();
+    std::shared_ptr<ToolBarTracer> stopTracing();
+    const std::shared_ptr<ToolBarTracer> &tracer() const
+    {
+        return m_tracer;
+    }
+    static std::shared_ptr<ToolBarTracer> tracer(const ToolBar *toolbar);
+
+    // emits stateChanged on the container holding a toolbar, if any
+    static void notifyStateChanged(const ToolBar *toolbar);
+
+    enum class DragState {
+        Idle,
+        MovingDockedToolBar,
+        MovingFloatingToolBar,
+        ResizingToolBar,
+        DraggingAction,
+    };
+    DragState dragState() const;
+
 signals:
     void toolBarAboutToBeInserted(const KDToolBars::ToolBar *toolbar, int index);
     void toolBarInserted(const KDToolBars::ToolBar *toolbar);
     void toolBarAboutToBeRemoved(const KDToolBars::ToolBar *toolbar, int index);
     void toolBarRemoved();
+    // emitted when something that is saved changes: toolbars moved, resized, docked, shown or hidden,
+    // customized or restored
+    void stateChanged();
 
 private:
     friend class ToolBarTrayLayout;
@@ -79,15 +152,44 @@ private:
     };
     void insertToolBar(ToolBarTrayLayout *trayLayout, ToolBar *before, ToolBar *toolbar);
     int trayIndex(ToolBarTray tray) const;
+    static ToolBarContainerLayout *containerLayout(const ToolBar *toolbar);
     std::array<ToolBarTrayLayout *, TrayCount> m_trays;
     std::vector<ToolBar *> m_toolbars;
     std::unordered_map<const ToolBar *, ToolBarTrayLayout *> m_toolbarTray;
     QLayoutItem *m_centralWidgetLayoutItem = nullptr;
-    std::unique_ptr<QWidget> m_actionContainer;
+    ToolBarActionRegistry *m_actionRegistry;
+    bool m_rowPacking = false;
+    bool m_locked = false;
+    int m_lastRestoreChanges = 0;
+    mutable ToolBarPerformanceCounters m_performanceCounters;
+    std::shared_ptr<ToolBarTracer> m_tracer;
 
     template<typename TraySizeGetterT, typename WidgetSizeGetterT>
     QSize layoutSize(TraySizeGetterT traySize, WidgetSizeGetterT widgetSize) const;
 
+    // size hint and minimum size, valid until one of the trays changes size
+    struct SizeCache
+    {
+        QSize sizeHint;
+        QSize minimumSize;
+        std::array<int, TrayCount> traySizeGenerations;
+    };
+    void updateSizeCache() const;
+    mutable std::optional<SizeCache> m_sizeCache;
+
+    // results of previous layouts, most recently used first, flushed whenever the layout is
+    // invalidated; lets interactive resizes that go back and forth skip laying out the trays
+    struct LayoutResult
+    {
+        QRect contentsRect;
+        std::array<QRect, TrayCount> trayRects;
+        std::array<QVector<ToolBarTrayLayout::ItemGeometry>, TrayCount> trayGeometries;
+        QRect centralWidgetRect;
+    };
+    static constexpr int kMaxCachedLayoutResults = 8;
+    const LayoutResult &layoutResult(const QRect &contentsRect);
+    std::vector<LayoutResult> m_layoutResults;
+
     ToolBarTrayLayout *topTray() const
     {
         return m_trays[TopTray];
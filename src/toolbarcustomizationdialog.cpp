@@ -127,23 +127,17 @@ ToolBarCustomizationDialog::ToolBarCustomizationDialog(MainWindow *mainWindow, Q
             this, {},
             tr("All your changes will be lost! Do you really want to reset all toolbars?"),
             QMessageBox::Yes | QMessageBox::No);
-        if (button == QMessageBox::Yes) {
-            const int count = m_mainWindow->toolBarCount();
-            for (int i = 0; i < count; ++i) {
-                auto toolbar = m_mainWindow->toolBarAt(i);
-                toolbar->reset();
-            }
-        }
+        if (button == QMessageBox::Yes)
+            m_mainWindow->resetToolBars();
     });
     connect(m_newToolBar, &QPushButton::clicked, this, [this] {
         bool ok;
         QString title = QInputDialog::getText(
             this, {}, tr("Toolbar Name:"), QLineEdit::Normal, {}, &ok);
         if (ok && !title.isEmpty()) {
-            auto toolbar = new ToolBar(ToolBarOption::IsCustom);
-            toolbar->setWindowTitle(title);
-            m_mainWindow->addToolBar(toolbar);
-            toolbar->show();
+            auto *d = m_mainWindow->d;
+            d->m_undoStack->push(new CustomToolBarCommand(m_mainWindow, d->m_layout, &d->m_undoStateCache, title,
+                                                          tr("New Toolbar")));
         }
     });
     connect(m_renameToolBar, &QPushButton::clicked, this, [this, sortModel] {
@@ -154,9 +148,10 @@ ToolBarCustomizationDialog::ToolBarCustomizationDialog(MainWindow *mainWindow, Q
         bool ok;
         QString title = QInputDialog::getText(
             this, {}, tr("Toolbar Name:"), QLineEdit::Normal, name, &ok);
-        if (ok && !title.isEmpty()) {
-            auto toolbar = index.data(ToolBarListModel::ToolBarRole).value<ToolBar *>();
-            toolbar->setWindowTitle(title);
+        if (ok && !title.isEmpty() && title != name) {
+            auto *toolbar = index.data(ToolBarListModel::ToolBarRole).value<ToolBar *>();
+            m_mainWindow->d->m_undoStack->push(new RenameToolBarCommand(m_mainWindow->d->m_layout, toolbar, title,
+                                                                        tr("Rename Toolbar")));
         }
     });
     connect(m_deleteToolBar, &QPushButton::clicked, this, [this, sortModel] {
@@ -169,9 +164,10 @@ ToolBarCustomizationDialog::ToolBarCustomizationDialog(MainWindow *mainWindow, Q
             tr("Do you really want to delete the toolbar '%1'?").arg(name),
             QMessageBox::Yes | QMessageBox::No);
         if (button == QMessageBox::Yes) {
-            auto toolbar = index.data(ToolBarListModel::ToolBarRole).value<ToolBar *>();
-            m_mainWindow->removeToolBar(toolbar);
-            delete toolbar;
+            auto *d = m_mainWindow->d;
+            auto *toolbar = index.data(ToolBarListModel::ToolBarRole).value<ToolBar *>();
+            d->m_undoStack->push(new CustomToolBarCommand(m_mainWindow, d->m_layout, &d->m_undoStateCache, toolbar,
+                                                          tr("Delete Toolbar")));
         }
     });
     connect(m_renameToolBar, &QPushButton::clicked, this, []() {});
@@ -0,0 +1,138 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "toolbardebugoverlay.h"
+
+#include "toolbar.h"
+#include "toolbarcontainerlayout.h"
+
+#include <QFontDatabase>
+#include <QPainter>
+
+using namespace KDToolBars;
+
+namespace {
+constexpr int kRefreshInterval = 500; // msecs
+constexpr int kMargin = 8;
+constexpr int kPadding = 6;
+constexpr int kMaxToolBarLines = 20;
+
+using Counter = ToolBarPerformanceCounters::Counter;
+
+// counters may have been reset since the last sample
+Counter delta(const Counter &counter, const Counter &last)
+{
+    if (counter.count < last.count)
+        return counter;
+    return Counter { counter.count - last.count, counter.nsecs - last.nsecs };
+}
+
+QString dragStateName(ToolBarContainerLayout::DragState state)
+{
+    switch (state) {
+    case ToolBarContainerLayout::DragState::Idle:
+        return QStringLiteral("idle");
+    case ToolBarContainerLayout::DragState::MovingDockedToolBar:
+        return QStringLiteral("moving docked toolbar");
+    case ToolBarContainerLayout::DragState::MovingFloatingToolBar:
+        return QStringLiteral("moving floating toolbar");
+    case ToolBarContainerLayout::DragState::ResizingToolBar:
+        return QStringLiteral("resizing toolbar");
+    case ToolBarContainerLayout::DragState::DraggingAction:
+        return QStringLiteral("dragging action");
+    }
+    return {};
+}
+} // namespace
+
+ToolBarDebugOverlay::ToolBarDebugOverlay(ToolBarContainerLayout *layout, QWidget *container)
+    : QWidget(container)
+    , m_layout(layout)
+    , m_lastCounters(*layout->performanceCounters())
+{
+    setObjectName(QStringLiteral("kdtoolbars-debug-overlay"));
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    container->installEventFilter(this);
+
+    m_sampleTimer.start();
+    m_timer.setInterval(kRefreshInterval);
+    m_timerConnection = connect(&m_timer, &QTimer::timeout, this, &ToolBarDebugOverlay::refresh);
+    m_timer.start();
+    refresh();
+}
+
+ToolBarDebugOverlay::~ToolBarDebugOverlay() = default;
+
+int ToolBarDebugOverlay::connectionCount() const
+{
+    return m_timerConnection ? 1 : 0;
+}
+
+void ToolBarDebugOverlay::refresh()
+{
+    const auto counters = *m_layout->performanceCounters();
+    const auto secs = std::max(m_sampleTimer.restart(), qint64(1)) / 1000.0;
+
+    const auto passes = delta(counters.layoutPasses, m_lastCounters.layoutPasses);
+    const auto toolbarLayouts = delta(counters.toolBarLayoutUpdates, m_lastCounters.toolBarLayoutUpdates);
+    const auto searches = delta(counters.dynamicLayoutSearches, m_lastCounters.dynamicLayoutSearches);
+    m_lastCounters = counters;
+
+    m_lines.clear();
+    const auto msecsPerPass = passes.count > 0 ? passes.nsecs / 1e6 / passes.count : 0.0;
+    m_lines.append(QStringLiteral("layout: %1 ms/pass, %2 passes/s").arg(msecsPerPass, 0, 'f', 2).arg(passes.count / secs, 0, 'f', 1));
+    m_lines.append(QStringLiteral("toolbar layouts: %1/s, layout searches: %2/s").arg(toolbarLayouts.count / secs, 0, 'f', 1).arg(searches.count / secs, 0, 'f', 1));
+    m_lines.append(QStringLiteral("drag: %1").arg(dragStateName(m_layout->dragState())));
+
+    const auto toolbarCount = m_layout->toolBarCount();
+    for (int i = 0; i < std::min(toolbarCount, kMaxToolBarLines); ++i) {
+        const auto *toolbar = m_layout->toolBarAt(i);
+        const auto name = toolbar->objectName().isEmpty() ? toolbar->windowTitle() : toolbar->objectName();
+        m_lines.append(QStringLiteral("%1: %2 widgets%3").arg(name).arg(toolbar->layout()->count()).arg(toolbar->isFloating() ? QStringLiteral(" (floating)") : QString()));
+    }
+    if (toolbarCount > kMaxToolBarLines)
+        m_lines.append(QStringLiteral("%1 more toolbars").arg(toolbarCount - kMaxToolBarLines));
+
+    reposition();
+    raise(); // toolbars added since the last refresh are stacked above
+    update();
+}
+
+void ToolBarDebugOverlay::reposition()
+{
+    const auto metrics = fontMetrics();
+    int width = 0;
+    for (const auto &line : std::as_const(m_lines))
+        width = std::max(width, metrics.horizontalAdvance(line));
+    const auto size = QSize(width, metrics.lineSpacing() * static_cast<int>(m_lines.size())) + QSize(2 * kPadding, 2 * kPadding);
+    const auto topRight = parentWidget()->rect().topRight() + QPoint(-kMargin, kMargin);
+    setGeometry(QRect(topRight - QPoint(size.width() - 1, 0), size));
+}
+
+void ToolBarDebugOverlay::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(0, 0, 0, 180));
+    painter.setPen(Qt::white);
+    const auto lineSpacing = fontMetrics().lineSpacing();
+    auto textRect = rect().adjusted(kPadding, kPadding, -kPadding, -kPadding);
+    for (const auto &line : std::as_const(m_lines)) {
+        painter.drawText(textRect, Qt::AlignLeft | Qt::AlignTop, line);
+        textRect.setTop(textRect.top() + lineSpacing);
+    }
+}
+
+bool ToolBarDebugOverlay::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == parentWidget() && event->type() == QEvent::Resize)
+        reposition();
+    return QWidget::eventFilter(watched, event);
+}
@@ -0,0 +1,56 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "mainwindow.h"
+
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QWidget>
+
+namespace KDToolBars {
+
+class ToolBarContainerLayout;
+
+// Shows the performance counters of a toolbar container, sampled a few times per second, in a box
+// in the top right corner of the container. The overlay isn't part of the container layout and
+// doesn't take mouse events.
+class ToolBarDebugOverlay : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ToolBarDebugOverlay(ToolBarContainerLayout *layout, QWidget *container);
+    ~ToolBarDebugOverlay() override;
+
+    QStringList lines() const
+    {
+        return m_lines;
+    }
+
+    int connectionCount() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void refresh();
+    void reposition();
+
+    ToolBarContainerLayout *m_layout;
+    QTimer m_timer;
+    QMetaObject::Connection m_timerConnection;
+    QElapsedTimer m_sampleTimer;
+    ToolBarPerformanceCounters m_lastCounters;
+    QStringList m_lines;
+};
+
+} // namespace KDToolBars
@@ -11,7 +11,13 @@
 #include "toolbarlayout.h"
 
 #include "toolbar.h"
+#include "toolbarcontainerlayout.h"
+#include "toolbarmemoryusage_p.h"
+#include "toolbarperformancecounters_p.h"
 #include "toolbarseparator.h"
+#include "toolbarstatecodec.h"
+#include "toolbartracer.h"
+#include "tracehooks_p.h"
 
 #include <QStyleOptionToolButton>
 
@@ -46,12 +52,14 @@ ToolBarLayout::~ToolBarLayout()
 void ToolBarLayout::invalidate()
 {
     m_dirty = true;
+    m_itemsFingerprint.reset(); // item size hints may have changed
     QLayout::invalidate();
 }
 
 void ToolBarLayout::addItem(QLayoutItem *item)
 {
     m_rowBreaks.clear();
+    m_itemsFingerprint.reset();
     m_items.append(item);
     invalidate();
 }
@@ -82,6 +90,7 @@ QLayoutItem *ToolBarLayout::takeAt(int index)
             return nullptr;
         if (index < m_items.count()) {
             m_rowBreaks.clear();
+            m_itemsFingerprint.reset();
             return m_items.takeAt(index);
         }
         if (index == m_items.count()) {
@@ -120,6 +129,9 @@ void ToolBarLayout::updateGeometries() const
 {
     if (!m_dirty)
         return;
+    KDTOOLBARS_TRACE_SCOPE("ToolBarLayout::updateGeometries");
+    ScopedPerformanceCounter counter(ToolBarContainerLayout::performanceCounters(m_toolbar), &ToolBarPerformanceCounters::toolBarLayoutUpdates);
+    ScopedTraceSpan span(ToolBarContainerLayout::tracer(m_toolbar), "toolBarLayout", "layout", m_toolbar);
 
     // initialize item geometries and size hint
 
@@ -188,9 +200,13 @@ void ToolBarLayout::updateGeometries() const
             break;
         }
         case LayoutType::Dynamic: {
-            initializeDynamicLayouts();
-            if (m_rowBreaks.empty())
-                m_rowBreaks = m_dynamicLayouts.front().rowBreaks;
+            if (m_rowBreaks.empty()) {
+                ensureDynamicLayouts();
+                const auto &layout = m_dynamicLayouts.front();
+                m_rowBreaks = layout.rowBreaks;
+                m_dynamicLayoutSize = layout.minimumSize;
+                m_dynamicLayoutFingerprint = m_dynamicLayoutsFingerprint;
+            }
             if (!m_rowBreaks.empty())
                 layoutRows(m_rowBreaks);
             break;
@@ -204,6 +220,7 @@ void ToolBarLayout::updateGeometries() const
 
 void ToolBarLayout::layoutRows(const std::vector<int> &rowBreaks) const
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBarLayout::layoutRows");
     // figure out maximum row width
     int rowStart = 0;
     int maxRowWidth = 0;
@@ -266,6 +283,7 @@ void ToolBarLayout::layoutRows(const std::vector<int> &rowBreaks) const
 
 void ToolBarLayout::setGeometry(const QRect &geometry)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBarLayout::setGeometry");
     QLayout::setGeometry(geometry);
 
     if (m_dirty)
@@ -275,9 +293,13 @@ void ToolBarLayout::setGeometry(const QRect &geometry)
 
     const auto contentsRect = geometry.marginsRemoved(innerContentsMargins());
     const auto contentsTopLeft = contentsRect.topLeft();
-    for (const auto &row : std::as_const(m_itemRows)) {
-        for (auto &item : row.items)
-            item.item->setGeometry(item.geometry.translated(contentsTopLeft));
+    {
+        ScopedPerformanceCounter counter(ToolBarContainerLayout::performanceCounters(m_toolbar), &ToolBarPerformanceCounters::widgetGeometryUpdates,
+                                         m_items.size());
+        for (const auto &row : std::as_const(m_itemRows)) {
+            for (auto &item : row.items)
+                item.item->setGeometry(item.geometry.translated(contentsTopLeft));
+        }
     }
 
     // KDAB_TODO: hide invisible widgets and show visible ones, as done by
@@ -330,6 +352,7 @@ void ToolBarLayout::insertWidget(int index, QWidget *widget, ToolBarWidgetType t
     if (type == ToolBarWidgetType::StandardButton)
         item->setAlignment(Qt::AlignJustify);
     m_rowBreaks.clear();
+    m_itemsFingerprint.reset();
     m_items.insert(index, item);
     invalidate();
 }
@@ -355,6 +378,10 @@ void ToolBarLayout::setCloseButton(QWidget *widget)
 
 void ToolBarLayout::initializeDynamicLayouts() const
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBarLayout::initializeDynamicLayouts");
+    ScopedPerformanceCounter counter(ToolBarContainerLayout::performanceCounters(m_toolbar), &ToolBarPerformanceCounters::dynamicLayoutSearches);
+    ScopedTraceSpan span(ToolBarContainerLayout::tracer(m_toolbar), "dynamicLayoutSearch", "layout", m_toolbar);
+
     struct Item
     {
         QSize size;
@@ -460,6 +487,44 @@ void ToolBarLayout::initializeDynamicLayouts() const
     }
 }
 
+void ToolBarLayout::ensureDynamicLayouts() const
+{
+    const auto fingerprint = itemsFingerprint();
+    if (!m_dynamicLayouts.empty() && fingerprint == m_dynamicLayoutsFingerprint)
+        return;
+    initializeDynamicLayouts();
+    m_dynamicLayoutsFingerprint = fingerprint;
+}
+
+quint64 ToolBarLayout::itemsFingerprint() const
+{
+    if (!m_itemsFingerprint)
+        m_itemsFingerprint = computeItemsFingerprint();
+    return *m_itemsFingerprint;
+}
+
+quint64 ToolBarLayout::computeItemsFingerprint() const
+{
+    // FNV-1a over everything the layout search depends on, stable across runs
+    quint64 hash = 14695981039346656037ull;
+    const auto combine = [&hash](int value) {
+        const auto v = static_cast<quint32>(value);
+        for (int i = 0; i < 4; ++i) {
+            hash ^= (v >> (8 * i)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+    combine(spacing());
+    combine(static_cast<int>(m_items.size()));
+    for (auto *item : m_items) {
+        const auto size = item->sizeHint();
+        combine(size.width());
+        combine(size.height());
+        combine(isSeparator(item) ? 1 : 0);
+    }
+    return hash;
+}
+
 const ToolBarLayout::DynamicLayout *ToolBarLayout::preferredLayoutForSize(QSize availableSize) const
 {
     if (m_items.empty())
@@ -476,6 +541,7 @@ const ToolBarLayout::DynamicLayout *ToolBarLayout::preferredLayoutForSize(QSize
 
 ToolBarLayout::DropSite ToolBarLayout::findDropSite(QPoint layoutPos) const
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBarLayout::findDropSite");
     if (m_dirty)
         updateGeometries();
 
@@ -589,13 +655,21 @@ int ToolBarLayout::handleExtent() const
 
 int ToolBarLayout::handleExtent(bool floating) const
 {
-    if (floating)
+    if (floating || !m_handleVisible)
         return 0;
     QStyleOption opt;
     opt.initFrom(m_toolbar);
     return m_toolbar->style()->pixelMetric(QStyle::PM_ToolBarHandleExtent, &opt, m_toolbar);
 }
 
+void ToolBarLayout::setHandleVisible(bool visible)
+{
+    if (visible == m_handleVisible)
+        return;
+    m_handleVisible = visible;
+    invalidate();
+}
+
 QRect ToolBarLayout::handleArea() const
 {
     int left, top, right, bottom;
@@ -615,8 +689,8 @@ QRect ToolBarLayout::handleArea() const
 
 QSize ToolBarLayout::adjustToWidth(int width)
 {
-    if (m_dirty)
-        initializeDynamicLayouts();
+    KDTOOLBARS_TRACE_SCOPE("ToolBarLayout::adjustToWidth");
+    ensureDynamicLayouts();
     if (m_dynamicLayouts.empty())
         return QSize(0, 0);
     const auto &layout = [this, width]() -> const DynamicLayout & {
@@ -636,14 +710,16 @@ QSize ToolBarLayout::adjustToWidth(int width)
         m_rowBreaks = layout.rowBreaks;
         invalidate();
     }
+    m_dynamicLayoutSize = layout.minimumSize;
+    m_dynamicLayoutFingerprint = m_dynamicLayoutsFingerprint;
     const auto contentsSize = layout.minimumSize;
     return contentsSize.expandedTo(m_minimumSize).grownBy(innerContentsMargins());
 }
 
 QSize ToolBarLayout::adjustToHeight(int height)
 {
-    if (m_dirty)
-        initializeDynamicLayouts();
+    KDTOOLBARS_TRACE_SCOPE("ToolBarLayout::adjustToHeight");
+    ensureDynamicLayouts();
     if (m_dynamicLayouts.empty())
         return QSize(0, 0);
     const auto &layout = [this, height]() -> const DynamicLayout & {
@@ -663,6 +739,8 @@ QSize ToolBarLayout::adjustToHeight(int height)
         m_rowBreaks = layout.rowBreaks;
         invalidate();
     }
+    m_dynamicLayoutSize = layout.minimumSize;
+    m_dynamicLayoutFingerprint = m_dynamicLayoutsFingerprint;
     const auto contentsSize = layout.minimumSize;
     return contentsSize.expandedTo(m_minimumSize).grownBy(innerContentsMargins());
 }
@@ -780,35 +858,100 @@ ToolBarLayoutState ToolBarLayout::state() const
 {
     ToolBarLayoutState state;
     state.rowBreaks = m_rowBreaks;
+    if (m_toolbar->isFloating() && !m_rowBreaks.empty() && m_dynamicLayoutSize.isValid()
+        && m_dynamicLayoutFingerprint == itemsFingerprint()) {
+        state.itemsFingerprint = m_dynamicLayoutFingerprint;
+        state.dynamicLayoutSize = m_dynamicLayoutSize;
+    }
     return state;
 }
 
+int ToolBarLayout::dynamicLayoutCount() const
+{
+    return static_cast<int>(m_dynamicLayouts.size());
+}
+
+qint64 ToolBarLayout::dynamicLayoutBytes() const
+{
+    return heapBytes(m_dynamicLayouts);
+}
+
 void ToolBarLayout::applyState(const ToolBarLayoutState &state)
 {
     const auto &rowBreaks = state.rowBreaks;
     if (rowBreaks.empty())
         return;
-    const auto valid = std::all_of(rowBreaks.begin(), rowBreaks.end(), [this](int rowEnd) {
+    const auto isValid = std::all_of(rowBreaks.begin(), rowBreaks.end(), [this](int rowEnd) {
         return rowEnd > 0 && rowEnd <= m_items.count();
     });
-    if (!valid)
+    if (!isValid)
+        return;
+
+    // the layout of a floating toolbar is reused as is if the items didn't change, otherwise the
+    // layout search picks a new one; the candidate layouts are only searched for on resize
+    if (state.dynamicLayoutSize.isValid() && state.itemsFingerprint != itemsFingerprint())
+        return;
+    m_dynamicLayoutSize = state.dynamicLayoutSize;
+    m_dynamicLayoutFingerprint = state.itemsFingerprint;
+
+    if (rowBreaks == m_rowBreaks)
         return;
     m_rowBreaks = rowBreaks;
     invalidate();
 }
 
-void ToolBarLayoutState::save(QDataStream &stream) const
+void ToolBarLayoutState::save(StateWriter &writer) const
 {
-    stream << static_cast<int>(rowBreaks.size());
+    writer.writeUInt(static_cast<quint32>(rowBreaks.size()));
     for (auto rowEnd : rowBreaks)
-        stream << rowEnd;
+        writer.writeInt(rowEnd);
+
+    writer.writeBool(dynamicLayoutSize.isValid());
+    if (!dynamicLayoutSize.isValid())
+        return;
+    writer.writeUInt(static_cast<quint32>(itemsFingerprint));
+    writer.writeUInt(static_cast<quint32>(itemsFingerprint >> 32));
+    writer.writeInt(dynamicLayoutSize.width());
+    writer.writeInt(dynamicLayoutSize.height());
+}
+
+bool ToolBarLayoutState::load(StateReader &reader)
+{
+    rowBreaks.clear();
+    int count;
+    if (!reader.readCount(count))
+        return false;
+    rowBreaks.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        int rowEnd;
+        if (!reader.readInt(rowEnd))
+            return false;
+        rowBreaks.push_back(rowEnd);
+    }
+
+    itemsFingerprint = 0;
+    dynamicLayoutSize = QSize();
+    bool hasDynamicLayout;
+    if (!reader.readBool(hasDynamicLayout))
+        return false;
+    if (!hasDynamicLayout)
+        return true;
+    quint32 fingerprintLow, fingerprintHigh;
+    int width, height;
+    if (!reader.readUInt(fingerprintLow) || !reader.readUInt(fingerprintHigh)
+        || !reader.readInt(width) || !reader.readInt(height))
+        return false;
+    itemsFingerprint = (static_cast<quint64>(fingerprintHigh) << 32) | fingerprintLow;
+    dynamicLayoutSize = QSize(width, height);
+    return dynamicLayoutSize.isValid();
 }
 
 bool ToolBarLayoutState::load(QDataStream &stream)
 {
     rowBreaks.clear();
     int count;
-    stream >> count;
+    if (!readCount(stream, count, sizeof(int)))
+        return false;
     rowBreaks.reserve(count);
     for (int i = 0; i < count; ++i) {
         int rowEnd;
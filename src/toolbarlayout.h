@@ -14,15 +14,26 @@
 
 #include <QLayout>
 
+#include <optional>
+
 namespace KDToolBars {
 
 class ToolBar;
+class StateWriter;
+class StateReader;
 
 struct ToolBarLayoutState
 {
     std::vector<int> rowBreaks;
 
-    void save(QDataStream &stream) const;
+    // minimum size of the layout a floating toolbar had selected, its row breaks are only reapplied
+    // on restore if the items still have the same sizes
+    quint64 itemsFingerprint = 0;
+    QSize dynamicLayoutSize;
+
+    void save(StateWriter &writer) const;
+    bool load(StateReader &reader);
+    // v1 format
     bool load(QDataStream &stream);
 };
 
@@ -44,6 +55,9 @@ public:
     int handleExtent() const;
     QRect handleArea() const;
 
+    // the handle of docked toolbars is hidden when the toolbar layout is locked
+    void setHandleVisible(bool visible);
+
     enum ToolBarWidgetType {
         StandardButton,
         Separator,
@@ -83,16 +97,20 @@ public:
     ToolBarLayoutState state() const;
     void applyState(const ToolBarLayoutState &state);
 
-private:
-    int titleHeight(bool floating) const;
-    int handleExtent(bool floating) const;
-
     struct DynamicLayout
     {
         QSize minimumSize;
         std::vector<int> rowBreaks;
     };
 
+    // candidate layouts of a floating toolbar, kept until its items change size
+    int dynamicLayoutCount() const;
+    qint64 dynamicLayoutBytes() const;
+
+private:
+    int titleHeight(bool floating) const;
+    int handleExtent(bool floating) const;
+
     enum class LayoutType {
         Horizontal,
         Vertical,
@@ -105,6 +123,11 @@ private:
     void updateGeometries() const;
     void layoutRows(const std::vector<int> &rowBreaks) const;
     void initializeDynamicLayouts() const;
+    // runs the layout search only if the items changed size since the last time
+    void ensureDynamicLayouts() const;
+    // cached until the layout is invalidated, computing it asks every item for its size hint
+    quint64 itemsFingerprint() const;
+    quint64 computeItemsFingerprint() const;
     const DynamicLayout *preferredLayoutForSize(QSize availableSize) const;
 
     ToolBar *m_toolbar;
@@ -125,9 +148,15 @@ private:
     mutable bool m_dirty = true;
     int m_columns = 1; // only used if m_layoutType == LayoutType::Columns
     mutable std::vector<DynamicLayout> m_dynamicLayouts;
+    mutable quint64 m_dynamicLayoutsFingerprint = 0;
+    // the layout m_rowBreaks was taken from, which may have been restored without a search
+    mutable QSize m_dynamicLayoutSize;
+    mutable quint64 m_dynamicLayoutFingerprint = 0;
+    mutable std::optional<quint64> m_itemsFingerprint;
     mutable std::vector<int> m_rowBreaks;
     QRect m_geometry;
     QSize m_minimumSize;
+    bool m_handleVisible = true;
 };
 
 } // namespace KDToolBars
@@ -0,0 +1,75 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "toolbarmemoryusage_p.h"
+
+#include "toolbar_p.h"
+#include "toolbartraylayout.h"
+
+#include <QIcon>
+
+#include <cmath>
+
+using namespace KDToolBars;
+
+namespace {
+constexpr int kBytesPerPixel = 4; // ARGB32
+}
+
+qint64 KDToolBars::heapBytes(const QString &string)
+{
+    if (string.isDetached())
+        return static_cast<qint64>(string.capacity()) * static_cast<qint64>(sizeof(QChar));
+    return 0;
+}
+
+qint64 KDToolBars::heapBytes(const std::vector<ToolBarLayout::DynamicLayout> &dynamicLayouts)
+{
+    qint64 bytes = heapBytes<ToolBarLayout::DynamicLayout>(dynamicLayouts);
+    for (const auto &layout : dynamicLayouts)
+        bytes += heapBytes(layout.rowBreaks);
+    return bytes;
+}
+
+qint64 KDToolBars::heapBytes(const ToolBarLayoutState &state)
+{
+    return heapBytes(state.rowBreaks);
+}
+
+qint64 KDToolBars::heapBytes(const ToolBarState &state)
+{
+    qint64 bytes = heapBytes(state.actions) + heapBytes(state.layoutState);
+    for (const auto &action : state.actions)
+        bytes += heapBytes(action.objectName);
+    return bytes;
+}
+
+qint64 KDToolBars::heapBytes(const ToolBarTrayLayoutState &state)
+{
+    qint64 bytes = heapBytes(state.rows);
+    for (const auto &row : state.rows) {
+        bytes += heapBytes(row.items);
+        for (const auto &item : row.items)
+            bytes += heapBytes(item.objectName) + heapBytes(item.toolBarState);
+    }
+    return bytes;
+}
+
+qint64 KDToolBars::iconPixmapBytes(const QIcon &icon, QSize iconSize, qreal devicePixelRatio, IconPixmapKeys &pixmapKeys)
+{
+    if (icon.isNull())
+        return 0;
+    const auto size = icon.actualSize(iconSize);
+    const auto width = static_cast<int>(std::ceil(size.width() * devicePixelRatio));
+    const auto height = static_cast<int>(std::ceil(size.height() * devicePixelRatio));
+    if (!pixmapKeys.emplace(icon.cacheKey(), width, height).second)
+        return 0;
+    return static_cast<qint64>(width) * height * kBytesPerPixel;
+}
@@ -0,0 +1,34 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QtGlobal>
+
+namespace KDToolBars {
+
+// Memory held by toolbars. Byte counts are estimates of the heap memory of the containers and
+// pixmaps involved, widgets are only counted.
+struct ToolBarMemoryUsage
+{
+    int childWidgetCount = 0; // buttons, separators, custom widgets, close buttons and drop indicators
+    int connectionCount = 0; // signal connections made by the library that are still connected
+    qint64 pixmapBytes = 0; // pixmaps cached for the button icons once they're painted
+    int dynamicLayoutCount = 0; // candidate layouts of floating toolbars
+    qint64 dynamicLayoutBytes = 0;
+    qint64 stateBytes = 0; // states kept to be applied, reset to or undone
+
+    qint64 totalBytes() const
+    {
+        return pixmapBytes + dynamicLayoutBytes + stateBytes;
+    }
+};
+
+} // namespace KDToolBars
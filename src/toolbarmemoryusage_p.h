@@ -0,0 +1,59 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "toolbarlayout.h"
+
+#include <QMetaObject>
+
+#include <algorithm>
+#include <set>
+#include <tuple>
+#include <vector>
+
+class QIcon;
+
+namespace KDToolBars {
+
+struct ToolBarState;
+struct ToolBarTrayLayoutState;
+
+// Estimates of the heap memory owned by a value, not counting the value itself or implicitly
+// shared data it doesn't hold alone
+
+template<typename T>
+qint64 heapBytes(const std::vector<T> &vector)
+{
+    return static_cast<qint64>(vector.capacity() * sizeof(T));
+}
+
+qint64 heapBytes(const QString &string);
+qint64 heapBytes(const std::vector<ToolBarLayout::DynamicLayout> &dynamicLayouts);
+qint64 heapBytes(const ToolBarLayoutState &state);
+qint64 heapBytes(const ToolBarState &state);
+qint64 heapBytes(const ToolBarTrayLayoutState &state);
+
+// Connections made by the library are kept to count the ones that weren't broken since, by
+// disconnecting or destroying either end
+template<typename Connections>
+int connectedCount(const Connections &connections)
+{
+    return static_cast<int>(std::count_if(std::begin(connections), std::end(connections), [](const QMetaObject::Connection &connection) {
+        return static_cast<bool>(connection);
+    }));
+}
+
+// Icons keep one pixmap per size they were painted at, icons shared by several buttons are only
+// counted once for every size: the key is the cache key of the icon and the pixmap size
+using IconPixmapKeys = std::set<std::tuple<qint64, int, int>>;
+qint64 iconPixmapBytes(const QIcon &icon, QSize iconSize, qreal devicePixelRatio, IconPixmapKeys &pixmapKeys);
+
+} // namespace KDToolBars
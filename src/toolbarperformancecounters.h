@@ -0,0 +1,35 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QtGlobal>
+
+namespace KDToolBars {
+
+// Work done laying out the toolbars of a main window since its counters were last reset. Times are
+// in nanoseconds and include the time spent in nested counted calls.
+struct ToolBarPerformanceCounters
+{
+    struct Counter
+    {
+        quint64 count = 0;
+        qint64 nsecs = 0;
+    };
+    Counter layoutPasses; // main window layouts, laying out all trays at once
+    Counter toolBarLayoutUpdates; // item geometries of a toolbar computed
+    Counter dynamicLayoutSearches; // candidate layouts of a floating toolbar computed
+    Counter trayRowSizeUpdates; // sizes of the rows of a tray computed
+    Counter trayLayouts; // geometries of the toolbars in a tray computed
+    Counter widgetGeometryUpdates; // geometries of buttons, separators and toolbars set
+    Counter dockTransitions; // toolbars docked or undocked
+};
+
+} // namespace KDToolBars
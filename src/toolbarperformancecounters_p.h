@@ -0,0 +1,52 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "toolbarperformancecounters.h"
+
+#include <QElapsedTimer>
+
+namespace KDToolBars {
+
+// Adds a call and its duration to one of the counters when going out of scope, does nothing without
+// counters
+class ScopedPerformanceCounter
+{
+public:
+    using Counter = ToolBarPerformanceCounters::Counter;
+
+    explicit ScopedPerformanceCounter(ToolBarPerformanceCounters *counters, Counter ToolBarPerformanceCounters::*counter,
+                                      quint64 count = 1)
+        : m_counter(counters != nullptr ? &(counters->*counter) : nullptr)
+        , m_count(count)
+    {
+        if (m_counter != nullptr)
+            m_timer.start();
+    }
+
+    ~ScopedPerformanceCounter()
+    {
+        if (m_counter != nullptr) {
+            m_counter->count += m_count;
+            m_counter->nsecs += m_timer.nsecsElapsed();
+        }
+    }
+
+    ScopedPerformanceCounter(const ScopedPerformanceCounter &) = delete;
+    ScopedPerformanceCounter &operator=(const ScopedPerformanceCounter &) = delete;
+
+private:
+    Counter *const m_counter;
+    const quint64 m_count;
+    QElapsedTimer m_timer;
+};
+
+} // namespace KDToolBars
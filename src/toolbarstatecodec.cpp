@@ -0,0 +1,192 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "toolbarstatecodec.h"
+
+#include <QIODevice>
+
+#include <array>
+
+using namespace KDToolBars;
+
+namespace {
+
+quint32 crc32(const QByteArray &data)
+{
+    static const auto table = [] {
+        std::array<quint32, 256> table;
+        for (quint32 i = 0; i < 256; ++i) {
+            auto value = i;
+            for (int j = 0; j < 8; ++j)
+                value = (value & 1) ? (value >> 1) ^ 0xedb88320u : value >> 1;
+            table[i] = value;
+        }
+        return table;
+    }();
+    quint32 crc = 0xffffffffu;
+    for (const auto byte : data)
+        crc = table[(crc ^ static_cast<quint8>(byte)) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffu;
+}
+
+void appendVarint(QByteArray &data, quint32 value)
+{
+    while (value >= 0x80) {
+        data.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.append(static_cast<char>(value));
+}
+
+} // namespace
+
+void StateWriter::writeUInt(quint32 value)
+{
+    appendVarint(m_body, value);
+}
+
+void StateWriter::writeInt(int value)
+{
+    // zigzag encoding, so that small negative values stay small
+    const auto v = static_cast<quint32>(value);
+    writeUInt((v << 1) ^ (value < 0 ? 0xffffffffu : 0u));
+}
+
+void StateWriter::writeBool(bool value)
+{
+    writeUInt(value ? 1 : 0);
+}
+
+void StateWriter::writeString(const QString &string)
+{
+    auto it = m_stringIndex.find(string);
+    if (it == m_stringIndex.end()) {
+        it = m_stringIndex.insert(string, static_cast<quint32>(m_strings.size()));
+        m_strings.append(string);
+    }
+    writeUInt(it.value());
+}
+
+void StateWriter::writeTo(QDataStream &stream) const
+{
+    QByteArray payload;
+    appendVarint(payload, static_cast<quint32>(m_strings.size()));
+    for (const auto &string : m_strings) {
+        const auto utf8 = string.toUtf8();
+        appendVarint(payload, static_cast<quint32>(utf8.size()));
+        payload.append(utf8);
+    }
+    payload.append(m_body);
+
+    stream << static_cast<quint32>(payload.size()) << crc32(payload);
+    stream.writeRawData(payload.constData(), payload.size());
+}
+
+StateReader::StateReader(QDataStream &stream)
+{
+    quint32 length, checksum;
+    stream >> length >> checksum;
+    if (stream.status() != QDataStream::Ok || stream.device() == nullptr)
+        return;
+    if (length > static_cast<quint64>(stream.device()->bytesAvailable()))
+        return;
+
+    m_data.resize(static_cast<int>(length));
+    if (stream.readRawData(m_data.data(), m_data.size()) != m_data.size())
+        return;
+    if (crc32(m_data) != checksum)
+        return;
+
+    m_valid = true;
+
+    int stringCount;
+    if (!readCount(stringCount))
+        return;
+    m_strings.reserve(stringCount);
+    for (int i = 0; i < stringCount; ++i) {
+        int size;
+        if (!readCount(size))
+            return;
+        m_strings.append(QString::fromUtf8(m_data.constData() + m_pos, size));
+        m_pos += size;
+    }
+}
+
+bool StateReader::readUInt(quint32 &value)
+{
+    if (!m_valid)
+        return false;
+    value = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        if (m_pos == m_data.size())
+            break;
+        const auto byte = static_cast<quint8>(m_data.at(m_pos++));
+        value |= static_cast<quint32>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    // truncated or longer than five bytes
+    m_valid = false;
+    return false;
+}
+
+bool StateReader::readInt(int &value)
+{
+    quint32 v;
+    if (!readUInt(v))
+        return false;
+    value = static_cast<int>((v >> 1) ^ (0u - (v & 1)));
+    return true;
+}
+
+bool StateReader::readBool(bool &value)
+{
+    quint32 v;
+    if (!readUInt(v))
+        return false;
+    value = v != 0;
+    return true;
+}
+
+bool StateReader::readString(QString &string)
+{
+    quint32 index;
+    if (!readUInt(index))
+        return false;
+    if (index >= static_cast<quint32>(m_strings.size())) {
+        m_valid = false;
+        return false;
+    }
+    string = m_strings.at(static_cast<int>(index));
+    return true;
+}
+
+bool StateReader::readCount(int &count)
+{
+    quint32 value;
+    if (!readUInt(value))
+        return false;
+    if (value > static_cast<quint32>(m_data.size() - m_pos)) {
+        m_valid = false;
+        return false;
+    }
+    count = static_cast<int>(value);
+    return true;
+}
+
+bool KDToolBars::readCount(QDataStream &stream, int &count, int minElementSize)
+{
+    stream >> count;
+    if (stream.status() != QDataStream::Ok || count < 0)
+        return false;
+    if (stream.device() == nullptr)
+        return false;
+    return count <= stream.device()->bytesAvailable() / minElementSize;
+}
@@ -0,0 +1,74 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QHash>
+#include <QStringList>
+
+namespace KDToolBars {
+
+// Encoding of the v2 toolbar state format. The serialized state is a header with the length and
+// CRC-32 of the payload, followed by the payload: a table with every string used in the state,
+// then the state itself, where counts and positions are varints and strings are table indices.
+class StateWriter
+{
+public:
+    void writeUInt(quint32 value);
+    void writeInt(int value);
+    void writeBool(bool value);
+    void writeString(const QString &string);
+
+    void writeTo(QDataStream &stream) const;
+
+private:
+    QByteArray m_body;
+    QStringList m_strings;
+    QHash<QString, quint32> m_stringIndex;
+};
+
+class StateReader
+{
+public:
+    // reads and verifies the header, the string table is parsed up front
+    explicit StateReader(QDataStream &stream);
+
+    bool isValid() const
+    {
+        return m_valid;
+    }
+
+    bool readUInt(quint32 &value);
+    bool readInt(int &value);
+    bool readBool(bool &value);
+    bool readString(QString &string);
+    // every encoded element takes at least one byte, so counts larger than the remaining data are
+    // rejected before anything gets allocated
+    bool readCount(int &count);
+
+    bool atEnd() const
+    {
+        return m_pos == m_data.size();
+    }
+
+private:
+    QByteArray m_data;
+    int m_pos = 0;
+    QStringList m_strings;
+    bool m_valid = false;
+};
+
+// reads a count from a v1 state stream, rejecting counts for elements of at least minElementSize
+// bytes that couldn't fit in what's left of the stream
+bool readCount(QDataStream &stream, int &count, int minElementSize);
+
+} // namespace KDToolBars
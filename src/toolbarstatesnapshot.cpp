@@ -0,0 +1,54 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "toolbarstatesnapshot.h"
+#include "toolbarstatesnapshot_p.h"
+
+#include <QDataStream>
+#include <QIODevice>
+
+using namespace KDToolBars;
+
+ToolBarStateSnapshot::ToolBarStateSnapshot() = default;
+
+ToolBarStateSnapshot::~ToolBarStateSnapshot() = default;
+
+ToolBarStateSnapshot::ToolBarStateSnapshot(const ToolBarStateSnapshot &other) = default;
+
+ToolBarStateSnapshot &ToolBarStateSnapshot::operator=(const ToolBarStateSnapshot &other) = default;
+
+ToolBarStateSnapshot::ToolBarStateSnapshot(ToolBarStateSnapshot &&other) noexcept = default;
+
+ToolBarStateSnapshot &ToolBarStateSnapshot::operator=(ToolBarStateSnapshot &&other) noexcept = default;
+
+ToolBarStateSnapshot ToolBarStateSnapshot::fromByteArray(const QByteArray &data)
+{
+    QDataStream stream(data);
+    auto snapshotData = std::make_shared<Data>();
+    ToolBarStateSnapshot snapshot;
+    if (ToolBarContainerLayout::decodeState(stream, snapshotData->trayStates))
+        snapshot.d = std::move(snapshotData);
+    return snapshot;
+}
+
+QByteArray ToolBarStateSnapshot::toByteArray() const
+{
+    QByteArray data;
+    if (d != nullptr) {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        ToolBarContainerLayout::encodeState(d->trayStates, stream);
+    }
+    return data;
+}
+
+bool ToolBarStateSnapshot::isValid() const
+{
+    return d != nullptr;
+}
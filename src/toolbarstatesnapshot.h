@@ -0,0 +1,48 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "kdtoolbars_export.h"
+
+#include <QByteArray>
+
+#include <memory>
+
+namespace KDToolBars {
+
+// Decoded and validated toolbar state, as saved by MainWindow::saveToolBarState.
+// Snapshots are immutable and cheap to copy, and can be created and passed around on any thread;
+// only applying them with MainWindow::restoreToolBarState needs the GUI thread.
+class KDTOOLBARS_EXPORT ToolBarStateSnapshot
+{
+public:
+    ToolBarStateSnapshot();
+    ~ToolBarStateSnapshot();
+
+    ToolBarStateSnapshot(const ToolBarStateSnapshot &other);
+    ToolBarStateSnapshot &operator=(const ToolBarStateSnapshot &other);
+    ToolBarStateSnapshot(ToolBarStateSnapshot &&other) noexcept;
+    ToolBarStateSnapshot &operator=(ToolBarStateSnapshot &&other) noexcept;
+
+    // Returns an invalid snapshot if the data is corrupt or of an unknown version
+    static ToolBarStateSnapshot fromByteArray(const QByteArray &data);
+    QByteArray toByteArray() const;
+
+    bool isValid() const;
+
+private:
+    friend class MainWindow;
+
+    struct Data;
+    std::shared_ptr<const Data> d;
+};
+
+} // namespace KDToolBars
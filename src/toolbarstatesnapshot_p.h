@@ -0,0 +1,23 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "toolbarstatesnapshot.h"
+#include "toolbarcontainerlayout.h"
+
+namespace KDToolBars {
+
+struct ToolBarStateSnapshot::Data
+{
+    ToolBarContainerLayout::TrayStates trayStates;
+};
+
+} // namespace KDToolBars
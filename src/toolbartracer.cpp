@@ -0,0 +1,98 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "toolbartracer.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QWidget>
+
+using namespace KDToolBars;
+
+namespace {
+// toolbars are usually named, custom ones only have a title
+QString toolBarName(const QWidget *toolbar)
+{
+    const auto name = toolbar->objectName();
+    return name.isEmpty() ? toolbar->windowTitle() : name;
+}
+} // namespace
+
+ToolBarTracer::ToolBarTracer()
+{
+    m_timer.start();
+}
+
+void ToolBarTracer::addSpan(const char *name, const char *category, qint64 start, qint64 end, const QString &toolbar)
+{
+    m_spans.push_back(Span { name, category, start, end - start, toolbar });
+}
+
+QByteArray ToolBarTracer::toJson() const
+{
+    // all the work is done on the GUI thread
+    const auto pid = QCoreApplication::applicationPid();
+    constexpr int tid = 1;
+
+    QJsonArray events;
+    for (const auto &span : m_spans) {
+        // timestamps are in microseconds
+        QJsonObject event {
+            { QStringLiteral("name"), QLatin1String(span.name) },
+            { QStringLiteral("cat"), QLatin1String(span.category) },
+            { QStringLiteral("ph"), QStringLiteral("X") },
+            { QStringLiteral("ts"), span.start / 1000.0 },
+            { QStringLiteral("dur"), span.duration / 1000.0 },
+            { QStringLiteral("pid"), pid },
+            { QStringLiteral("tid"), tid },
+        };
+        if (!span.toolbar.isEmpty())
+            event.insert(QStringLiteral("args"), QJsonObject { { QStringLiteral("toolbar"), span.toolbar } });
+        events.append(event);
+    }
+
+    const QJsonObject trace {
+        { QStringLiteral("traceEvents"), events },
+        { QStringLiteral("displayTimeUnit"), QStringLiteral("ns") },
+    };
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+bool ToolBarTracer::save(const QString &fileName) const
+{
+    const auto data = toJson();
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning("ToolBarTracer: Failed to write %s: %s", qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+    return true;
+}
+
+ScopedTraceSpan::ScopedTraceSpan(std::shared_ptr<ToolBarTracer> tracer, const char *name, const char *category, const QWidget *toolbar)
+    : m_tracer(std::move(tracer))
+    , m_name(name)
+    , m_category(category)
+{
+    if (m_tracer == nullptr)
+        return;
+    if (toolbar != nullptr)
+        m_toolbar = toolBarName(toolbar);
+    m_start = m_tracer->elapsed();
+}
+
+ScopedTraceSpan::~ScopedTraceSpan()
+{
+    if (m_tracer != nullptr)
+        m_tracer->addSpan(m_name, m_category, m_start, m_tracer->elapsed(), m_toolbar);
+}
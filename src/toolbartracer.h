@@ -0,0 +1,77 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+class QWidget;
+
+namespace KDToolBars {
+
+// Spans of toolbar work recorded while tracing, written as Chrome trace events (the JSON format
+// read by Perfetto and chrome://tracing). Spans are complete events, so nested spans show up as
+// nested slices.
+class ToolBarTracer
+{
+public:
+    ToolBarTracer();
+
+    // nsecs since tracing started
+    qint64 elapsed() const
+    {
+        return m_timer.nsecsElapsed();
+    }
+
+    void addSpan(const char *name, const char *category, qint64 start, qint64 end, const QString &toolbar);
+    int spanCount() const
+    {
+        return static_cast<int>(m_spans.size());
+    }
+
+    QByteArray toJson() const;
+    bool save(const QString &fileName) const;
+
+private:
+    struct Span
+    {
+        const char *name;
+        const char *category;
+        qint64 start;
+        qint64 duration;
+        QString toolbar; // empty for spans not tied to a toolbar
+    };
+    QElapsedTimer m_timer;
+    std::vector<Span> m_spans;
+};
+
+// Records a span from construction to destruction, does nothing without a tracer
+class ScopedTraceSpan
+{
+public:
+    explicit ScopedTraceSpan(std::shared_ptr<ToolBarTracer> tracer, const char *name, const char *category, const QWidget *toolbar = nullptr);
+    ~ScopedTraceSpan();
+
+    ScopedTraceSpan(const ScopedTraceSpan &) = delete;
+    ScopedTraceSpan &operator=(const ScopedTraceSpan &) = delete;
+
+private:
+    const std::shared_ptr<ToolBarTracer> m_tracer;
+    const char *const m_name;
+    const char *const m_category;
+    qint64 m_start = 0;
+    QString m_toolbar;
+};
+
+} // namespace KDToolBars
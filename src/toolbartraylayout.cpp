@@ -13,13 +13,28 @@
 #include "toolbar.h"
 #include "toolbar_p.h"
 #include "toolbarcontainerlayout.h"
+#include "toolbarperformancecounters_p.h"
+#include "toolbartracer.h"
+#include "tracehooks_p.h"
+#include "toolbarstatecodec.h"
 
 #include <QtWidgets/private/qlayout_p.h>
 
+#include <algorithm>
+#include <limits>
+
 using namespace KDToolBars;
 
 // clazy:excludeall=detaching-member
 
+namespace {
+// toolbars that haven't been shown yet only because their window hasn't are not hidden
+bool isExplicitlyHidden(const ToolBar *toolbar)
+{
+    return toolbar->isHidden() && toolbar->testAttribute(Qt::WA_WState_ExplicitShowHide);
+}
+} // namespace
+
 ToolBarTrayLayout::ToolBarTrayLayout(
     ToolBarTray tray, Qt::Orientation orientation, ToolBarContainerLayout *parent)
     : m_parent(parent)
@@ -73,24 +88,14 @@ QSize ToolBarTrayLayout::sizeHint() const
 {
     if (m_dirty)
         updateRowSizes();
-    auto size = QSize(0, 0);
-    for (const auto &row : m_rows) {
-        rpick(size) = std::max(pick(size), pick(row.sizeHint));
-        rperp(size) += perp(row.sizeHint);
-    }
-    return size.grownBy(m_contentsMargins);
+    return m_sizeHint;
 }
 
 QSize ToolBarTrayLayout::minimumSize() const
 {
     if (m_dirty)
         updateRowSizes();
-    auto size = QSize(0, 0);
-    for (const auto &row : m_rows) {
-        rpick(size) = std::max(pick(size), pick(row.minimumSize));
-        rperp(size) += perp(row.minimumSize);
-    }
-    return size.grownBy(m_contentsMargins);
+    return m_minimumSize;
 }
 
 void ToolBarTrayLayout::invalidate()
@@ -101,17 +106,65 @@ void ToolBarTrayLayout::invalidate()
 void ToolBarTrayLayout::setGeometry(QRect rect)
 {
     m_contentsRect = rect.marginsRemoved(m_contentsMargins);
-    doLayout();
+    setAvailableExtent(pick(m_contentsRect.size()));
+}
+
+void ToolBarTrayLayout::setRowPackingEnabled(bool enabled)
+{
+    if (enabled == m_rowPacking)
+        return;
+    m_rowPacking = enabled;
+    invalidate();
+}
+
+void ToolBarTrayLayout::setAvailableExtent(int extent)
+{
+    if (extent == m_availableExtent)
+        return;
+    m_availableExtent = extent;
+    if (!m_rowPacking || m_dirty)
+        return;
+    // only pack rows again if a line break would move
+    if (extent >= m_packedMinExtent && extent < m_packedMaxExtent)
+        return;
+    packRows();
+    updateRowPositions();
 }
 
-void ToolBarTrayLayout::doLayout()
+ToolBarTrayLayout::Geometries ToolBarTrayLayout::computeGeometries() const
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBarTrayLayout::computeGeometries");
+    ScopedPerformanceCounter counter(m_parent->performanceCounters(), &ToolBarPerformanceCounters::trayLayouts);
+    ScopedTraceSpan span(m_parent->tracer(), "trayLayout", "layout");
+
     if (m_dirty)
         updateRowSizes();
 
-    const auto topLeft = m_contentsRect.topLeft();
+    const auto availableSize = pick(m_contentsRect.size());
+
+    Geometries geometries;
+    geometries.reserve(count());
 
     for (const auto &row : std::as_const(m_rows)) {
+        if (m_rowPacking && !row.hasMovingToolBar) {
+            int lineStart = 0;
+            int linePos = row.pos;
+            for (const auto &line : row.lines) {
+                QVector<Item> items(row.sortedItems.begin() + lineStart, row.sortedItems.begin() + line.end);
+                if (lineStart > 0) {
+                    // wrapped lines start at the beginning of the row, keeping the relative positions
+                    const auto offset = items.front().pos;
+                    for (auto &item : items)
+                        item.pos -= offset;
+                }
+                adjustItemPositions(items, availableSize);
+                appendItemGeometries(items, linePos, geometries);
+                linePos += line.extent;
+                lineStart = line.end;
+            }
+            continue;
+        }
+
         QVector<Item> items;
 
         // find a toolbar that's being dragged in this row
@@ -133,33 +186,51 @@ void ToolBarTrayLayout::doLayout()
             std::stable_sort(items.begin(), items.end(), [](const auto &lhs, const auto &rhs) {
                 return lhs.pos < rhs.pos;
             });
+            adjustItemPositions(items, availableSize);
+        }
 
-            const auto availableSize = pick(m_contentsRect.size());
-            auto used = adjustItemSizes(items, availableSize);
+        appendItemGeometries(items, row.pos, geometries);
+    }
 
-            // adjust positions
-            auto start = 0;
-            for (auto &item : items) {
-                used -= item.size;
-                item.pos = std::max(std::min(item.pos, (availableSize - used) - item.size), start);
-                start = item.pos + item.size;
-            }
-        }
+    return geometries;
+}
 
-        for (const auto &item : std::as_const(items)) {
-            auto *widgetItem = item.widgetItem;
-            auto itemSize = widgetItem->sizeHint();
-            rpick(itemSize) = item.size;
-            QPoint pos;
-            rpick(pos) = item.pos;
-            rperp(pos) = row.pos;
-            widgetItem->setGeometry(QRect(topLeft + pos, itemSize));
-        }
+void ToolBarTrayLayout::applyGeometries(const Geometries &geometries)
+{
+    for (const auto &itemGeometry : geometries)
+        itemGeometry.item->setGeometry(itemGeometry.geometry);
+}
+
+void ToolBarTrayLayout::adjustItemPositions(QVector<Item> &items, int availableSize) const
+{
+    auto used = adjustItemSizes(items, availableSize);
+
+    // adjust positions
+    auto start = 0;
+    for (auto &item : items) {
+        used -= item.size;
+        item.pos = std::max(std::min(item.pos, (availableSize - used) - item.size), start);
+        start = item.pos + item.size;
+    }
+}
+
+void ToolBarTrayLayout::appendItemGeometries(const QVector<Item> &items, int rowPos, Geometries &geometries) const
+{
+    const auto topLeft = m_contentsRect.topLeft();
+    for (const auto &item : items) {
+        auto *widgetItem = item.widgetItem;
+        auto itemSize = widgetItem->sizeHint();
+        rpick(itemSize) = item.size;
+        QPoint pos;
+        rpick(pos) = item.pos;
+        rperp(pos) = rowPos;
+        geometries.append(ItemGeometry { widgetItem, QRect(topLeft + pos, itemSize) });
     }
 }
 
 void ToolBarTrayLayout::moveToolBar(ToolBar *toolbar, QPoint pos)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBarTrayLayout::moveToolBar");
     if (toolbar->isFloating())
         return;
     auto itemPath = findItem(toolbar);
@@ -391,32 +462,172 @@ void ToolBarTrayLayout::insertToolBarBreak(ToolBar *before)
     m_rows.insert(path->row, Row { std::move(leftItems), 0, {} });
 }
 
+QLayoutItem *ToolBarTrayLayout::takeToolBar(const ToolBar *toolbar)
+{
+    const auto path = findItem(toolbar);
+    if (!path)
+        return nullptr;
+    return std::get<0>(TakeLayoutItem(*path));
+}
+
+void ToolBarTrayLayout::placeToolBar(QLayoutItem *item, const ToolBarPlacement &placement)
+{
+    auto *toolbar = qobject_cast<ToolBar *>(item->widget());
+    Q_ASSERT(toolbar);
+
+    // rows that are still empty once all toolbars are placed are removed by removeEmptyRows
+    const auto row = std::max(placement.row, 0);
+    while (m_rows.count() <= row)
+        m_rows.push_back({});
+    // keep the items of the row ordered by position
+    const auto pos = std::max(placement.pos, 0);
+    auto &items = m_rows[row].items;
+    auto it = std::upper_bound(items.begin(), items.end(), pos, [](int pos, const Item &other) {
+        return pos < other.pos;
+    });
+    items.insert(it, Item { item, pos });
+
+    toolbar->setDockedOrientation(m_orientation);
+
+    if (placement.isFloating) {
+        const auto &geometry = placement.floatingGeometry;
+        if (!toolbar->isFloating())
+            toolbar->d->setWindowState(true, geometry.topLeft());
+        if (geometry.width() > 0)
+            toolbar->d->m_layout->adjustToWidth(geometry.width());
+        toolbar->move(geometry.topLeft());
+    } else if (toolbar->isFloating()) {
+        toolbar->d->setWindowState(false);
+    }
+}
+
+void ToolBarTrayLayout::insertRow(int row)
+{
+    m_rows.insert(std::clamp(row, 0, static_cast<int>(m_rows.count())), Row {});
+}
+
+void ToolBarTrayLayout::removeEmptyRows()
+{
+    auto it = std::remove_if(m_rows.begin(), m_rows.end(), [](const Row &row) {
+        return row.items.empty();
+    });
+    m_rows.erase(it, m_rows.end());
+}
+
 void ToolBarTrayLayout::updateRowSizes() const
 {
     if (!m_dirty)
         return;
+    KDTOOLBARS_TRACE_SCOPE("ToolBarTrayLayout::updateRowSizes");
+    ScopedPerformanceCounter counter(m_parent->performanceCounters(), &ToolBarPerformanceCounters::trayRowSizeUpdates);
     auto *that = const_cast<ToolBarTrayLayout *>(this);
-    int pos = 0;
     for (auto &row : that->m_rows) {
         auto sizeHint = QSize(0, 0);
         auto minimumSize = QSize(0, 0);
         auto &items = row.items;
-        for (const auto &item : items) {
-            const auto itemSizeHint = item.widgetItem->sizeHint();
-            rpick(sizeHint) += pick(itemSizeHint);
-            rperp(sizeHint) = std::max(perp(sizeHint), perp(itemSizeHint));
-            const auto itemMinimumSize = item.widgetItem->minimumSize();
-            rpick(minimumSize) += pick(itemMinimumSize);
-            rperp(minimumSize) = std::max(perp(minimumSize), perp(itemMinimumSize));
+        for (auto &item : items) {
+            item.sizeHint = item.widgetItem->sizeHint();
+            rpick(sizeHint) += pick(item.sizeHint);
+            rperp(sizeHint) = std::max(perp(sizeHint), perp(item.sizeHint));
+            item.minimumSize = item.widgetItem->minimumSize();
+            rpick(minimumSize) += pick(item.minimumSize);
+            rperp(minimumSize) = std::max(perp(minimumSize), perp(item.minimumSize));
         }
         row.sizeHint = sizeHint;
         row.minimumSize = minimumSize;
-        row.pos = pos;
-        pos += perp(sizeHint);
+
+        if (m_rowPacking) {
+            row.sortedItems = items;
+            std::stable_sort(row.sortedItems.begin(), row.sortedItems.end(), [](const auto &lhs, const auto &rhs) {
+                return lhs.pos < rhs.pos;
+            });
+            row.hasMovingToolBar = std::any_of(items.begin(), items.end(), [](const auto &item) {
+                auto *tb = qobject_cast<ToolBar *>(item.widgetItem->widget());
+                Q_ASSERT(tb != nullptr);
+                return tb->d->isMoving();
+            });
+        } else {
+            row.sortedItems.clear();
+            row.lines.clear();
+        }
     }
+    if (m_rowPacking)
+        packRows();
+    updateRowPositions();
     that->m_dirty = false;
 }
 
+void ToolBarTrayLayout::packRows() const
+{
+    // Next-fit packing of each row from the cached item sizes. We also keep track of the range of
+    // extents for which the result doesn't change, so resizing only packs rows again when a
+    // toolbar actually needs to wrap or unwrap.
+    KDTOOLBARS_TRACE_SCOPE("ToolBarTrayLayout::packRows");
+    auto *that = const_cast<ToolBarTrayLayout *>(this);
+    const auto extent = m_availableExtent < 0 ? std::numeric_limits<int>::max() : m_availableExtent;
+    int minExtent = 0;
+    int maxExtent = std::numeric_limits<int>::max();
+    for (auto &row : that->m_rows) {
+        if (row.hasMovingToolBar)
+            continue; // keep the row on a single line while a toolbar is being dragged in it
+
+        const auto &items = row.sortedItems;
+        row.lines.clear();
+        auto sizeHint = QSize(0, 0);
+        auto minimumSize = QSize(0, 0);
+        int lineStart = 0;
+        int used = 0;
+        int lineExtent = 0;
+        int lineMinimumExtent = 0;
+        const auto endLine = [&](int end) {
+            if (end - lineStart > 1)
+                minExtent = std::max(minExtent, used);
+            rpick(sizeHint) = std::max(pick(sizeHint), used);
+            rperp(sizeHint) += lineExtent;
+            rperp(minimumSize) += lineMinimumExtent;
+            row.lines.push_back(Line { end, lineExtent, lineMinimumExtent });
+            lineStart = end;
+            used = lineExtent = lineMinimumExtent = 0;
+        };
+        for (int i = 0, count = items.count(); i < count; ++i) {
+            const auto &item = items[i];
+            const auto size = pick(item.sizeHint);
+            if (i > lineStart && used + size > extent) {
+                maxExtent = std::min(maxExtent, used + size);
+                endLine(i);
+            }
+            used += size;
+            lineExtent = std::max(lineExtent, perp(item.sizeHint));
+            lineMinimumExtent = std::max(lineMinimumExtent, perp(item.minimumSize));
+            // every toolbar can be wrapped to its own line
+            rpick(minimumSize) = std::max(pick(minimumSize), pick(item.minimumSize));
+        }
+        if (!items.isEmpty())
+            endLine(items.count());
+        row.sizeHint = sizeHint;
+        row.minimumSize = minimumSize;
+    }
+    m_packedMinExtent = minExtent;
+    m_packedMaxExtent = maxExtent;
+}
+
+void ToolBarTrayLayout::updateRowPositions() const
+{
+    auto *that = const_cast<ToolBarTrayLayout *>(this);
+    auto sizeHint = QSize(0, 0);
+    auto minimumSize = QSize(0, 0);
+    for (auto &row : that->m_rows) {
+        row.pos = perp(sizeHint);
+        rpick(sizeHint) = std::max(pick(sizeHint), pick(row.sizeHint));
+        rperp(sizeHint) += perp(row.sizeHint);
+        rpick(minimumSize) = std::max(pick(minimumSize), pick(row.minimumSize));
+        rperp(minimumSize) += perp(row.minimumSize);
+    }
+    m_sizeHint = sizeHint.grownBy(m_contentsMargins);
+    m_minimumSize = minimumSize.grownBy(m_contentsMargins);
+    ++m_sizeGeneration;
+}
+
 std::optional<ToolBarTrayLayout::ItemPath> ToolBarTrayLayout::findItem(
     const QWidget *widget) const
 {
@@ -537,6 +748,7 @@ int ToolBarTrayLayout::adjustItemSizes(QVector<Item> &items, int availableSize)
 
 bool ToolBarTrayLayout::hoverToolBar(ToolBar *toolbar)
 {
+    KDTOOLBARS_TRACE_SCOPE("ToolBarTrayLayout::hoverToolBar");
     if (!toolbar->isFloating())
         return false;
 
@@ -639,6 +851,22 @@ bool ToolBarTrayLayout::hasToolBar(const ToolBar *toolbar) const
     return findItem(toolbar) != std::nullopt;
 }
 
+std::optional<ToolBarPlacement> ToolBarTrayLayout::placement(const ToolBar *toolbar) const
+{
+    const auto path = findItem(toolbar);
+    if (!path)
+        return std::nullopt;
+    // the toolbar itself is left for the caller to fill in
+    ToolBarPlacement placement;
+    placement.tray = m_tray;
+    placement.row = path->row;
+    placement.pos = m_rows[path->row].items[path->index].pos;
+    placement.isFloating = toolbar->isFloating();
+    if (placement.isFloating)
+        placement.floatingGeometry = QRect(toolbar->pos(), QSize());
+    return placement;
+}
+
 ToolBarTrayLayoutState ToolBarTrayLayout::state() const
 {
     ToolBarTrayLayoutState state;
@@ -658,7 +886,7 @@ ToolBarTrayLayoutState ToolBarTrayLayout::state() const
             itemState.isCustom = isCustom;
             itemState.pos = item.pos;
             itemState.objectName = isCustom ? tb->windowTitle() : tb->objectName();
-            itemState.isHidden = tb->isHidden();
+            itemState.isHidden = isExplicitlyHidden(tb);
             itemState.isFloating = tb->isFloating();
             itemState.floatingPos = tb->isFloating() ? tb->pos() : QPoint();
             itemState.toolBarState = tb->d->state();
@@ -669,55 +897,88 @@ ToolBarTrayLayoutState ToolBarTrayLayout::state() const
     return state;
 }
 
-void ToolBarTrayLayout::applyState(
-    const ToolBarTrayLayoutState &state, const std::vector<ToolBar *> &toolbars, const std::vector<QAction *> &actions)
+int ToolBarTrayLayout::applyState(const ToolBarTrayLayoutState &state, const ToolBarStateIndex &index)
 {
-    // remove all current toolbars
-    for (auto &row : m_rows) {
-        for (auto &item : row.items)
-            delete item.widgetItem;
+    KDTOOLBARS_TRACE_SCOPE("ToolBarTrayLayout::applyState");
+    // current layout items, reused for the toolbars that stay in this tray
+    std::unordered_map<const QWidget *, QLayoutItem *> currentItems;
+    for (const auto &row : std::as_const(m_rows)) {
+        for (const auto &item : row.items)
+            currentItems[item.widgetItem->widget()] = item.widgetItem;
     }
     m_rows.clear();
 
+    int changes = 0;
+
     for (const auto &rowState : state.rows) {
         QVector<Item> items;
         for (auto &itemState : rowState.items) {
-            ToolBar *toolbar = [this, &itemState, &toolbars]() -> ToolBar * {
+            ToolBar *toolbar = [this, &itemState, &index, &changes]() -> ToolBar * {
                 if (itemState.isCustom) {
+                    // reuse a custom toolbar with the same title that wasn't restored yet
+                    const auto customToolbars = index.customToolbars.values(itemState.objectName);
+                    for (auto *toolbar : customToolbars) {
+                        if (m_parent->m_toolbarTray.find(toolbar) == m_parent->m_toolbarTray.end())
+                            return toolbar;
+                    }
+
                     auto toolbar = new ToolBar(ToolBarOption::IsCustom);
                     toolbar->setWindowTitle(itemState.objectName);
 
                     m_parent->addChildWidget(toolbar);
                     m_parent->m_toolbars.push_back(toolbar); // TODO: rethink this
-                    m_parent->m_toolbarTray[toolbar] = this;
+                    toolbar->d->setLocked(m_parent->m_locked);
+                    ++changes;
 
                     return toolbar;
                 }
 
-                const auto &objectName = itemState.objectName;
-                if (objectName.isEmpty())
-                    return nullptr;
-                auto it = std::find_if(toolbars.begin(), toolbars.end(), [&objectName](auto *tb) {
-                    return tb->objectName() == objectName;
-                });
-                return it != toolbars.end() ? *it : nullptr;
+                return index.toolbars.value(itemState.objectName);
             }();
             if (toolbar == nullptr)
                 continue;
-            auto *widgetItem = QLayoutPrivate::createWidgetItem(m_parent, toolbar);
+            // a toolbar can only be restored once
+            auto &toolbarTray = m_parent->m_toolbarTray[toolbar];
+            if (toolbarTray != nullptr)
+                continue;
+            toolbarTray = this;
 
             Item item;
-            item.widgetItem = widgetItem;
+            item.widgetItem = [this, toolbar, &currentItems, &changes] {
+                auto it = currentItems.find(toolbar);
+                if (it == currentItems.end()) {
+                    ++changes;
+                    return QLayoutPrivate::createWidgetItem(m_parent, toolbar);
+                }
+                auto *widgetItem = it->second;
+                currentItems.erase(it);
+                return widgetItem;
+            }();
             item.pos = itemState.pos;
             items.append(item);
 
             toolbar->setDockedOrientation(m_orientation);
-            toolbar->setVisible(!itemState.isHidden);
-            toolbar->d->applyState(itemState.toolBarState, actions);
-            toolbar->d->setWindowState(itemState.isFloating);
-            if (itemState.isFloating) {
+            if (itemState.isHidden) {
+                if (!isExplicitlyHidden(toolbar)) {
+                    toolbar->setVisible(false);
+                    ++changes;
+                }
+                // creating the widgets of hidden toolbars waits until they're shown
+                toolbar->d->deferState(itemState.toolBarState, index);
+            } else {
+                changes += toolbar->d->applyState(itemState.toolBarState, index);
+            }
+            if (toolbar->isFloating() != itemState.isFloating) {
+                toolbar->d->setWindowState(itemState.isFloating);
+                ++changes;
+            }
+            if (itemState.isFloating && toolbar->pos() != itemState.floatingPos) {
                 toolbar->move(itemState.floatingPos);
             }
+            if (!itemState.isHidden && isExplicitlyHidden(toolbar)) {
+                toolbar->setVisible(true);
+                ++changes;
+            }
         }
         if (!items.isEmpty()) {
             Row row;
@@ -725,36 +986,84 @@ void ToolBarTrayLayout::applyState(
             m_rows.append(std::move(row));
         }
     }
+
+    // remove toolbars that are no longer in this tray
+    for (const auto &entry : currentItems) {
+        delete entry.second;
+        ++changes;
+    }
+
+    return changes;
 }
 
-void ToolBarTrayLayoutState::save(QDataStream &stream) const
+void ToolBarTrayLayoutState::save(StateWriter &writer) const
 {
-    stream << static_cast<int>(rows.size());
+    writer.writeUInt(static_cast<quint32>(rows.size()));
     for (const auto &row : rows) {
         const auto &items = row.items;
-        stream << static_cast<int>(items.size());
+        writer.writeUInt(static_cast<quint32>(items.size()));
         for (const auto &item : items) {
-            stream << item.isCustom;
-            stream << item.pos;
-            stream << item.objectName;
-            stream << item.isHidden;
-            stream << item.isFloating;
-            stream << item.floatingPos;
-            item.toolBarState.save(stream);
+            writer.writeUInt((item.isCustom ? 1 : 0) | (item.isHidden ? 2 : 0) | (item.isFloating ? 4 : 0));
+            writer.writeInt(item.pos);
+            writer.writeString(item.objectName);
+            if (item.isFloating) {
+                writer.writeInt(item.floatingPos.x());
+                writer.writeInt(item.floatingPos.y());
+            }
+            item.toolBarState.save(writer);
+        }
+    }
+}
+
+bool ToolBarTrayLayoutState::load(StateReader &reader)
+{
+    rows.clear();
+    int rowCount;
+    if (!reader.readCount(rowCount))
+        return false;
+    rows.reserve(rowCount);
+    for (int i = 0; i < rowCount; ++i) {
+        Row row;
+        int itemCount;
+        if (!reader.readCount(itemCount))
+            return false;
+        row.items.reserve(itemCount);
+        for (int j = 0; j < itemCount; ++j) {
+            Item item;
+            quint32 flags;
+            if (!reader.readUInt(flags) || !reader.readInt(item.pos) || !reader.readString(item.objectName))
+                return false;
+            item.isCustom = flags & 1;
+            item.isHidden = flags & 2;
+            item.isFloating = flags & 4;
+            if (item.isFloating) {
+                int x, y;
+                if (!reader.readInt(x) || !reader.readInt(y))
+                    return false;
+                item.floatingPos = QPoint(x, y);
+            }
+            if (!item.toolBarState.load(reader))
+                return false;
+            row.items.push_back(std::move(item));
         }
+        rows.push_back(std::move(row));
     }
+    return true;
 }
 
 bool ToolBarTrayLayoutState::load(QDataStream &stream)
 {
     rows.clear();
     int rowCount;
-    stream >> rowCount;
+    if (!readCount(stream, rowCount, sizeof(int)))
+        return false;
     rows.reserve(rowCount);
     for (int i = 0; i < rowCount; ++i) {
         Row row;
         int itemCount;
-        stream >> itemCount;
+        // flags, position, empty object name, floating position and empty toolbar state
+        if (!readCount(stream, itemCount, 27))
+            return false;
         row.items.reserve(itemCount);
         for (int j = 0; j < itemCount; ++j) {
             Item item;
@@ -764,7 +1073,8 @@ bool ToolBarTrayLayoutState::load(QDataStream &stream)
             stream >> item.isHidden;
             stream >> item.isFloating;
             stream >> item.floatingPos;
-            item.toolBarState.load(stream);
+            if (!item.toolBarState.load(stream))
+                return false;
             row.items.push_back(std::move(item));
         }
         rows.push_back(std::move(row));
@@ -40,7 +40,9 @@ struct ToolBarTrayLayoutState
     };
     std::vector<Row> rows;
 
-    void save(QDataStream &stream) const;
+    void save(StateWriter &writer) const;
+    bool load(StateReader &reader);
+    // v1 format
     bool load(QDataStream &stream);
 };
 
@@ -54,18 +56,54 @@ public:
     int count() const;
     QLayoutItem *itemAt(int index) const;
     QLayoutItem *takeAt(int index);
-    void setGeometry(QRect rect);
     QSize sizeHint() const;
     QSize minimumSize() const;
     void invalidate();
 
+    // Laying out the tray is split in computing the geometries of the toolbars and applying them,
+    // so that the results can be cached
+    struct ItemGeometry
+    {
+        QLayoutItem *item;
+        QRect geometry;
+    };
+    using Geometries = QVector<ItemGeometry>;
+    void setGeometry(QRect rect);
+    Geometries computeGeometries() const;
+    static void applyGeometries(const Geometries &geometries);
+
+    bool isDirty() const
+    {
+        return m_dirty;
+    }
+    // incremented every time the size of the tray is recomputed
+    int sizeGeneration() const
+    {
+        return m_sizeGeneration;
+    }
+
     void insertToolBar(ToolBar *before, ToolBar *toolbar);
     void insertToolBarBreak(ToolBar *before);
 
+    QLayoutItem *takeToolBar(const ToolBar *toolbar);
+    void placeToolBar(QLayoutItem *item, const ToolBarPlacement &placement);
+    // empty row for placeToolBar to fill, rows past the last one are appended
+    void insertRow(int row);
+    void removeEmptyRows();
+
     void moveToolBar(ToolBar *toolbar, QPoint pos);
     void adjustToolBarRow(const ToolBar *toolbar);
     bool hoverToolBar(ToolBar *toolbar);
 
+    // when row packing is enabled, toolbars that don't fit in the available extent wrap to a new line
+    // within their row, without changing their position within the row
+    void setRowPackingEnabled(bool enabled);
+    bool isRowPackingEnabled() const
+    {
+        return m_rowPacking;
+    }
+    void setAvailableExtent(int extent);
+
     int rowCount() const;
     Qt::Orientation orientation() const
     {
@@ -78,9 +116,11 @@ public:
     }
 
     bool hasToolBar(const ToolBar *toolbar) const;
+    std::optional<ToolBarPlacement> placement(const ToolBar *toolbar) const;
 
     ToolBarTrayLayoutState state() const;
-    void applyState(const ToolBarTrayLayoutState &state, const std::vector<ToolBar *> &toolbars, const std::vector<QAction *> &actions);
+    // reuses the layout items of toolbars that stay in the tray, returns the number of widgets touched
+    int applyState(const ToolBarTrayLayoutState &state, const ToolBarStateIndex &index);
 
 private:
     struct Item
@@ -88,18 +128,31 @@ private:
         QLayoutItem *widgetItem;
         int pos;
         int size;
+        // cached by updateRowSizes
+        QSize sizeHint;
+        QSize minimumSize;
     };
     struct ItemPath
     {
         int row;
         int index;
     };
+    struct Line
+    {
+        int end; // index past the last item of the line in Row::sortedItems
+        int extent; // perpendicular size of the line
+        int minimumExtent;
+    };
     struct Row
     {
         QVector<Item> items;
         int pos;
         QSize sizeHint;
         QSize minimumSize;
+        // only used when packing rows
+        QVector<Item> sortedItems;
+        std::vector<Line> lines;
+        bool hasMovingToolBar = false;
 
         int dockedCount() const;
     };
@@ -109,8 +162,11 @@ private:
     std::tuple<QLayoutItem *, bool> TakeLayoutItem(ItemPath path);
     QVector<Item> adjustRow(const Row &row, const ToolBar *pivot) const;
     int adjustItemSizes(QVector<Item> &items, int availableSize) const;
+    void adjustItemPositions(QVector<Item> &items, int availableSize) const;
+    void appendItemGeometries(const QVector<Item> &items, int rowPos, Geometries &geometries) const;
     void updateRowSizes() const;
-    void doLayout();
+    void packRows() const;
+    void updateRowPositions() const;
 
     int pick(QSize size) const
     {
@@ -152,6 +208,14 @@ private:
     QVector<Row> m_rows;
     QRect m_contentsRect;
     bool m_dirty = true;
+    bool m_rowPacking = false;
+    int m_availableExtent = -1;
+    // range of available extents for which the current row packing stays valid
+    mutable int m_packedMinExtent = 0;
+    mutable int m_packedMaxExtent = 0;
+    mutable QSize m_sizeHint;
+    mutable QSize m_minimumSize;
+    mutable int m_sizeGeneration = 0;
 };
 
 } // namespace KDToolBars
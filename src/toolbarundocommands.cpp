@@ -0,0 +1,229 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "toolbarundocommands.h"
+
+#include "toolbarcontainerlayout.h"
+
+#include <algorithm>
+
+using namespace KDToolBars;
+
+namespace {
+bool isSameState(const ToolBarState &state, const ToolBarState &other)
+{
+    const auto isSameAction = [](const ToolBarState::Action &action, const ToolBarState::Action &otherAction) {
+        return action.isSeparator == otherAction.isSeparator && action.objectName == otherAction.objectName;
+    };
+    return std::equal(state.actions.begin(), state.actions.end(), other.actions.begin(), other.actions.end(), isSameAction)
+        && state.layoutState.rowBreaks == other.layoutState.rowBreaks;
+}
+}
+
+ToolBarStateCache::ToolBarStateCache(ToolBarContainerLayout *layout)
+    : m_layout(layout)
+{
+}
+
+SharedToolBarState ToolBarStateCache::state(const ToolBar *toolbar)
+{
+    auto &cached = m_states[ToolBarContainerLayout::toolBarId(toolbar)];
+    auto state = m_layout->toolBarState(toolbar);
+    if (!cached || !isSameState(*cached, state))
+        cached = std::make_shared<const ToolBarState>(std::move(state));
+    return cached;
+}
+
+void ToolBarStateCache::addStates(ToolBarStateSet &states) const
+{
+    for (const auto &state : m_states)
+        states.insert(state.get());
+}
+
+void ToolBarStateCache::prune()
+{
+    for (auto it = m_states.begin(); it != m_states.end();) {
+        if (m_layout->findToolBar(it.key()) == nullptr)
+            it = m_states.erase(it);
+        else
+            ++it;
+    }
+}
+
+ToolBarActionsCommand::ToolBarActionsCommand(ToolBarContainerLayout *layout, std::vector<Change> changes, const QString &text)
+    : QUndoCommand(text)
+    , m_layout(layout)
+    , m_changes(std::move(changes))
+{
+}
+
+void ToolBarActionsCommand::undo()
+{
+    apply(false);
+}
+
+void ToolBarActionsCommand::redo()
+{
+    apply(true);
+}
+
+void ToolBarActionsCommand::addStates(ToolBarStateSet &states) const
+{
+    for (const auto &change : m_changes) {
+        states.insert(change.before.get());
+        states.insert(change.after.get());
+    }
+}
+
+void ToolBarActionsCommand::apply(bool after)
+{
+    if (m_applied == after)
+        return;
+    m_applied = after;
+    for (const auto &change : m_changes) {
+        if (auto *toolbar = m_layout->findToolBar(change.toolBarId))
+            m_layout->applyToolBarState(toolbar, after ? *change.after : *change.before);
+    }
+}
+
+CustomToolBarCommand::CustomToolBarCommand(MainWindow *mainWindow, ToolBarContainerLayout *layout, ToolBarStateCache *stateCache,
+                                           const QString &title, const QString &text)
+    : QUndoCommand(text)
+    , m_mainWindow(mainWindow)
+    , m_layout(layout)
+    , m_stateCache(stateCache)
+    , m_title(title)
+    , m_create(true)
+{
+}
+
+CustomToolBarCommand::CustomToolBarCommand(MainWindow *mainWindow, ToolBarContainerLayout *layout, ToolBarStateCache *stateCache,
+                                           const ToolBar *toolbar, const QString &text)
+    : QUndoCommand(text)
+    , m_mainWindow(mainWindow)
+    , m_layout(layout)
+    , m_stateCache(stateCache)
+    , m_title(toolbar->windowTitle())
+    , m_create(false)
+    , m_toolBarId(ToolBarContainerLayout::toolBarId(toolbar))
+{
+}
+
+void CustomToolBarCommand::undo()
+{
+    if (m_create)
+        deleteToolBar();
+    else
+        createToolBar();
+}
+
+void CustomToolBarCommand::redo()
+{
+    if (m_create)
+        createToolBar();
+    else
+        deleteToolBar();
+}
+
+void CustomToolBarCommand::addStates(ToolBarStateSet &states) const
+{
+    if (m_state)
+        states.insert(m_state.get());
+}
+
+void CustomToolBarCommand::createToolBar()
+{
+    auto *toolbar = new ToolBar(ToolBarOption::IsCustom);
+    toolbar->setWindowTitle(m_title);
+    if (m_toolBarId != 0)
+        ToolBarContainerLayout::setToolBarId(toolbar, m_toolBarId);
+    else
+        m_toolBarId = ToolBarContainerLayout::toolBarId(toolbar);
+    m_mainWindow->addToolBar(toolbar);
+    if (m_placement) {
+        auto placement = *m_placement;
+        placement.toolbar = toolbar;
+        std::optional<ToolBarPlacement> rowPlacement;
+        if (const auto *rowToolBar = m_rowToolBarId != 0 ? m_layout->findToolBar(m_rowToolBarId) : nullptr)
+            rowPlacement = m_layout->toolBarPlacement(rowToolBar);
+        if (rowPlacement && rowPlacement->tray == placement.tray) {
+            placement.row = rowPlacement->row;
+            m_mainWindow->placeToolBars({ placement });
+        } else {
+            m_layout->placeToolBarInNewRow(placement);
+        }
+    }
+    if (m_state)
+        m_layout->applyToolBarState(toolbar, *m_state);
+    toolbar->setVisible(!m_isHidden);
+}
+
+void CustomToolBarCommand::deleteToolBar()
+{
+    auto *toolbar = m_layout->findToolBar(m_toolBarId);
+    if (toolbar == nullptr)
+        return;
+    m_placement = m_layout->toolBarPlacement(toolbar);
+    m_rowToolBarId = 0;
+    if (m_placement) {
+        for (int i = 0, count = m_mainWindow->toolBarCount(); i < count; ++i) {
+            const auto *other = m_mainWindow->toolBarAt(i);
+            if (other == toolbar)
+                continue;
+            const auto otherPlacement = m_layout->toolBarPlacement(other);
+            if (otherPlacement && otherPlacement->tray == m_placement->tray && otherPlacement->row == m_placement->row) {
+                m_rowToolBarId = ToolBarContainerLayout::toolBarId(other);
+                break;
+            }
+        }
+    }
+    m_isHidden = toolbar->isHidden();
+    m_state = m_stateCache->state(toolbar);
+    m_mainWindow->removeToolBar(toolbar);
+    delete toolbar;
+}
+
+RenameToolBarCommand::RenameToolBarCommand(ToolBarContainerLayout *layout, const ToolBar *toolbar, const QString &newTitle,
+                                           const QString &text)
+    : QUndoCommand(text)
+    , m_layout(layout)
+    , m_toolBarId(ToolBarContainerLayout::toolBarId(toolbar))
+    , m_title(toolbar->windowTitle())
+    , m_newTitle(newTitle)
+{
+}
+
+void RenameToolBarCommand::undo()
+{
+    rename(m_title);
+}
+
+void RenameToolBarCommand::redo()
+{
+    rename(m_newTitle);
+}
+
+void RenameToolBarCommand::rename(const QString &title)
+{
+    if (auto *toolbar = m_layout->findToolBar(m_toolBarId)) {
+        toolbar->setWindowTitle(title);
+        emit m_layout->stateChanged();
+    }
+}
+
+void KDToolBars::addUndoStates(const QUndoCommand *command, ToolBarStateSet &states)
+{
+    if (const auto *actionsCommand = dynamic_cast<const ToolBarActionsCommand *>(command))
+        actionsCommand->addStates(states);
+    else if (const auto *customToolBarCommand = dynamic_cast<const CustomToolBarCommand *>(command))
+        customToolBarCommand->addStates(states);
+    for (int i = 0; i < command->childCount(); ++i)
+        addUndoStates(command->child(i), states);
+}
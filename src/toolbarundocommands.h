@@ -0,0 +1,134 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "mainwindow.h"
+#include "toolbar_p.h"
+
+#include <QHash>
+#include <QUndoCommand>
+
+#include <memory>
+#include <optional>
+#include <unordered_set>
+
+namespace KDToolBars {
+
+class ToolBarContainerLayout;
+
+// Undo steps never hold on to toolbar pointers, custom toolbars can be deleted and created again.
+// They find toolbars by id, titles of custom toolbars needn't be unique, and only touch the toolbars
+// they changed.
+
+using SharedToolBarState = std::shared_ptr<const ToolBarState>;
+// states held by the cache and by undo steps, to account for each shared state once
+using ToolBarStateSet = std::unordered_set<const ToolBarState *>;
+
+// Hands out the state of toolbars for undo steps, consecutive steps share the same state while a
+// toolbar doesn't change
+class ToolBarStateCache
+{
+public:
+    explicit ToolBarStateCache(ToolBarContainerLayout *layout);
+
+    SharedToolBarState state(const ToolBar *toolbar);
+    void addStates(ToolBarStateSet &states) const;
+    // drops the states of toolbars no longer in the layout, undo steps hold on to the ones they need
+    void prune();
+
+private:
+    ToolBarContainerLayout *m_layout;
+    QHash<quint64, SharedToolBarState> m_states; // by toolbar id
+};
+
+// Actions added, moved or removed by dragging them while customizing toolbars
+class ToolBarActionsCommand : public QUndoCommand
+{
+public:
+    struct Change
+    {
+        quint64 toolBarId;
+        SharedToolBarState before;
+        SharedToolBarState after;
+    };
+    // the changes are already applied when the command is pushed
+    explicit ToolBarActionsCommand(ToolBarContainerLayout *layout, std::vector<Change> changes, const QString &text);
+
+    void undo() override;
+    void redo() override;
+
+    void addStates(ToolBarStateSet &states) const;
+
+private:
+    void apply(bool after);
+
+    ToolBarContainerLayout *m_layout;
+    std::vector<Change> m_changes;
+    bool m_applied = true;
+};
+
+// Custom toolbar created or deleted in the customization dialog
+class CustomToolBarCommand : public QUndoCommand
+{
+public:
+    // creates a toolbar with the given title
+    explicit CustomToolBarCommand(MainWindow *mainWindow, ToolBarContainerLayout *layout, ToolBarStateCache *stateCache,
+                                  const QString &title, const QString &text);
+    // deletes the given toolbar
+    explicit CustomToolBarCommand(MainWindow *mainWindow, ToolBarContainerLayout *layout, ToolBarStateCache *stateCache,
+                                  const ToolBar *toolbar, const QString &text);
+
+    void undo() override;
+    void redo() override;
+
+    void addStates(ToolBarStateSet &states) const;
+
+private:
+    void createToolBar();
+    void deleteToolBar();
+
+    MainWindow *m_mainWindow;
+    ToolBarContainerLayout *m_layout;
+    ToolBarStateCache *m_stateCache;
+    QString m_title;
+    bool m_create;
+    quint64 m_toolBarId = 0; // the id of a created toolbar is only known once it's created
+    // where the toolbar was when it was deleted, new toolbars go to the top tray; it goes back to
+    // the row of one of the toolbars it shared its row with, or to a new row if it was alone
+    std::optional<ToolBarPlacement> m_placement;
+    quint64 m_rowToolBarId = 0;
+    bool m_isHidden = false;
+    SharedToolBarState m_state;
+};
+
+// Custom toolbar renamed in the customization dialog
+class RenameToolBarCommand : public QUndoCommand
+{
+public:
+    explicit RenameToolBarCommand(ToolBarContainerLayout *layout, const ToolBar *toolbar, const QString &newTitle,
+                                  const QString &text);
+
+    void undo() override;
+    void redo() override;
+
+private:
+    void rename(const QString &title);
+
+    ToolBarContainerLayout *m_layout;
+    quint64 m_toolBarId;
+    QString m_title;
+    QString m_newTitle;
+};
+
+// adds the states held by an undo step and its children
+void addUndoStates(const QUndoCommand *command, ToolBarStateSet &states);
+
+} // namespace KDToolBars
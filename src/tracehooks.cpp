@@ -0,0 +1,38 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "tracehooks_p.h"
+
+using namespace KDToolBars;
+
+namespace {
+TraceHooks s_traceHooks;
+} // namespace
+
+#if defined(KDTOOLBARS_TRACE_HOOKS)
+const TraceHooks &KDToolBars::traceHooks()
+{
+    return s_traceHooks;
+}
+#endif
+
+void KDToolBars::setTraceHooks(const TraceHooks &hooks)
+{
+    s_traceHooks = hooks;
+}
+
+bool KDToolBars::hasTraceHooksSupport()
+{
+#if defined(KDTOOLBARS_TRACE_HOOKS)
+    return true;
+#else
+    return false;
+#endif
+}
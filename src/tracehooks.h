@@ -0,0 +1,32 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "kdtoolbars_export.h"
+
+namespace KDToolBars {
+
+// Callbacks receiving the layout and event handling scopes instrumented in the library, to connect
+// an external profiler. Scopes are only instrumented if the library was built with the
+// KDToolBars_TRACE_HOOKS CMake option, otherwise the instrumentation compiles to nothing and the
+// hooks are never called. Scope names are string literals, and scopes nest on the GUI thread.
+struct TraceHooks
+{
+    void (*beginScope)(const char *name, void *userData) = nullptr;
+    void (*endScope)(const char *name, void *userData) = nullptr;
+    void *userData = nullptr;
+};
+
+// Must be called on the GUI thread, scopes that are already open end with the hooks they began with
+KDTOOLBARS_EXPORT void setTraceHooks(const TraceHooks &hooks);
+KDTOOLBARS_EXPORT bool hasTraceHooksSupport();
+
+} // namespace KDToolBars
@@ -0,0 +1,59 @@
+/*
+  This file is part of KDToolBars.
+
+  SPDX-FileCopyrightText: 2022 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-2.0-only OR GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "tracehooks.h"
+
+// KDTOOLBARS_TRACE_SCOPE(name) reports the enclosing scope to the hooks set with setTraceHooks.
+// Without KDTOOLBARS_TRACE_HOOKS it expands to an expression without any effect, so the disabled
+// build generates the same code as without instrumentation.
+#if defined(KDTOOLBARS_TRACE_HOOKS)
+
+namespace KDToolBars {
+
+const TraceHooks &traceHooks();
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : m_hooks(traceHooks())
+        , m_name(name)
+    {
+        if (m_hooks.beginScope != nullptr)
+            m_hooks.beginScope(m_name, m_hooks.userData);
+    }
+
+    ~TraceScope()
+    {
+        if (m_hooks.endScope != nullptr)
+            m_hooks.endScope(m_name, m_hooks.userData);
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const TraceHooks m_hooks;
+    const char *const m_name;
+};
+
+} // namespace KDToolBars
+
+#define KDTOOLBARS_TRACE_CONCAT_IMPL(a, b) a##b
+#define KDTOOLBARS_TRACE_CONCAT(a, b) KDTOOLBARS_TRACE_CONCAT_IMPL(a, b)
+#define KDTOOLBARS_TRACE_SCOPE(name) const KDToolBars::TraceScope KDTOOLBARS_TRACE_CONCAT(kdtoolbarsTraceScope, __LINE__)(name)
+
+#else
+
+#define KDTOOLBARS_TRACE_SCOPE(name) static_cast<void>(0)
+
+#endif
@@ -10,21 +10,100 @@
 
 #include <kdtoolbars/toolbar.h>
 #include <kdtoolbars/mainwindow.h>
+#include <kdtoolbars/toolbarstatesnapshot.h>
+#include <kdtoolbars/tracehooks.h>
 
+#include <QAbstractItemView>
 #include <QAction>
+#include <QApplication>
+#include <QDataStream>
+#include <QDialog>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMessageBox>
+#include <QMouseEvent>
+#include <QPixmap>
+#include <QPointer>
+#include <QPushButton>
+#include <QSet>
 #include <QTest>
 #include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QToolButton>
+#include <QUndoStack>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
 
 using namespace KDToolBars;
 
 Q_DECLARE_METATYPE(const KDToolBars::ToolBar *)
 
+namespace {
+// only the library connects to these signals, their receivers are the connections it made
+class ReceiverCountingToolBar : public ToolBar
+{
+public:
+    int receiverCount() const
+    {
+        return receivers(SIGNAL(iconSizeChanged(QSize))) + receivers(SIGNAL(toolButtonStyleChanged(Qt::ToolButtonStyle)));
+    }
+};
+
+class ReceiverCountingMainWindow : public MainWindow
+{
+public:
+    int receiverCount() const
+    {
+        return receivers(SIGNAL(iconSizeChanged(QSize))) + receivers(SIGNAL(toolButtonStyleChanged(Qt::ToolButtonStyle)));
+    }
+};
+
+class ReceiverCountingAction : public QAction
+{
+public:
+    using QAction::QAction;
+    int receiverCount() const
+    {
+        return receivers(SIGNAL(destroyed(QObject *))) + receivers(SIGNAL(objectNameChanged(QString)));
+    }
+};
+}
+
 class TestMainWindow : public QObject
 {
     Q_OBJECT
 private slots:
     void testSimple();
     void testSaveState();
+    void testRestoreCorruptState();
+    void testRestoreDuplicateNames();
+    void testRestoreDifferential();
+    void testRestoreHiddenToolBar();
+    void testStateSnapshot();
+    void testPerspectives();
+    void testAutoSave();
+    void testAutoSaveFloatingMove();
+    void testRestoreDestroyedAction();
+    void testRestoreFloatingLayout();
+    void testResetToolBars();
+    void testResetToolBarRow();
+    void testUndoStack();
+    void testUndoDeleteToolBar();
+    void testPlaceToolBars();
+    void testRowPacking();
+    void testLockedLayout();
+    void testResizeLayoutCache();
+    void testPerformanceCounters();
+    void testTrace();
+    void testTraceHooks();
+    void testDebugOverlay();
+    void testMemoryUsage();
 };
 
 void TestMainWindow::testSimple()
@@ -131,5 +210,953 @@ void TestMainWindow::testSaveState()
     QCOMPARE(tb.actions(), QList<QAction *>({ &a1, &a2 }));
 }
 
+void TestMainWindow::testRestoreCorruptState()
+{
+    MainWindow mw;
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+    mw.addToolBar(ToolBarTray::Bottom, &tb);
+
+    const auto state = mw.saveToolBarState();
+    mw.addToolBar(ToolBarTray::Right, &tb);
+
+    // truncated state
+    QVERIFY(!mw.restoreToolBarState(state.left(state.size() - 1)));
+    QCOMPARE(mw.toolBarTray(&tb), ToolBarTray::Right);
+
+    // checksum mismatch
+    auto corrupt = state;
+    corrupt[corrupt.size() - 1] = corrupt.at(corrupt.size() - 1) ^ 0x40;
+    QVERIFY(!mw.restoreToolBarState(corrupt));
+    QCOMPARE(mw.toolBarTray(&tb), ToolBarTray::Right);
+
+    QVERIFY(mw.restoreToolBarState(state));
+    QCOMPARE(mw.toolBarTray(&tb), ToolBarTray::Bottom);
+
+    // v1 state with the toolbar in the top tray
+    QByteArray v1State;
+    {
+        QDataStream stream(&v1State, QIODevice::WriteOnly);
+        stream << 1 << 1; // version marker, toolbar count
+        stream << 1 << 1; // top tray: one row with one toolbar
+        stream << false << 0 << QString("test-toolbar") << false << false << QPoint();
+        stream << 0 << 0; // no actions, no row breaks
+        for (int i = 0; i < 3; ++i)
+            stream << 0; // no rows in the other trays
+    }
+    QVERIFY(mw.restoreToolBarState(v1State));
+    QCOMPARE(mw.toolBarTray(&tb), ToolBarTray::Top);
+
+    // v1 state with a bogus row count
+    QByteArray hugeCount;
+    {
+        QDataStream stream(&hugeCount, QIODevice::WriteOnly);
+        stream << 1 << 1 << std::numeric_limits<int>::max();
+    }
+    QVERIFY(!mw.restoreToolBarState(hugeCount));
+    QCOMPARE(mw.toolBarTray(&tb), ToolBarTray::Top);
+}
+
+void TestMainWindow::testRestoreDuplicateNames()
+{
+    MainWindow mw;
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+    mw.addToolBar(&tb);
+
+    QAction a1;
+    a1.setObjectName("test-action");
+    QAction a2;
+    a2.setObjectName("test-action");
+    tb.addAction(&a1);
+
+    const auto state = mw.saveToolBarState();
+    tb.addAction(&a2);
+
+    // the first action with a duplicated name is restored, and the duplicate is reported
+    QTest::ignoreMessage(QtWarningMsg, "ToolBarActionRegistry: Duplicate action object name test-action");
+    QVERIFY(mw.restoreToolBarState(state));
+    QCOMPARE(tb.actions(), QList<QAction *>({ &a1 }));
+}
+
+void TestMainWindow::testRestoreDifferential()
+{
+    MainWindow mw;
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+    mw.addToolBar(&tb);
+
+    QAction a1, a2, a3;
+    a1.setObjectName("test-action-1");
+    a2.setObjectName("test-action-2");
+    a3.setObjectName("test-action-3");
+    tb.addAction(&a1);
+    tb.addSeparator();
+    tb.addAction(&a2);
+    tb.addAction(&a3);
+    const auto actions = tb.actions();
+
+    const auto buttonForAction = [&tb](QAction *action) -> QToolButton * {
+        const auto buttons = tb.findChildren<QToolButton *>();
+        for (auto *button : buttons) {
+            if (button->defaultAction() == action)
+                return button;
+        }
+        return nullptr;
+    };
+
+    const auto state = mw.saveToolBarState();
+    auto *button = buttonForAction(&a3);
+    QVERIFY(button != nullptr);
+
+    // restoring the current state doesn't touch anything
+    QVERIFY(mw.restoreToolBarState(state));
+    QCOMPARE(mw.lastRestoreChangeCount(), 0);
+    QCOMPARE(tb.actions(), actions);
+    QCOMPARE(buttonForAction(&a3), button);
+
+    // moving one action back only moves that action, and its button is kept
+    tb.insertAction(&a1, &a3);
+    QVERIFY(mw.restoreToolBarState(state));
+    QCOMPARE(mw.lastRestoreChangeCount(), 1);
+    QCOMPARE(tb.actions(), actions);
+    QCOMPARE(buttonForAction(&a3), button);
+
+    // removed actions are added back, the separator is reused
+    tb.removeAction(&a2);
+    QVERIFY(mw.restoreToolBarState(state));
+    QCOMPARE(mw.lastRestoreChangeCount(), 1);
+    QCOMPARE(tb.actions(), actions);
+}
+
+void TestMainWindow::testRestoreHiddenToolBar()
+{
+    MainWindow mw;
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+    mw.addToolBar(&tb);
+
+    QAction a1, a2;
+    a1.setObjectName("test-action-1");
+    a2.setObjectName("test-action-2");
+    tb.addAction(&a1);
+    tb.addAction(&a2);
+
+    tb.hide();
+    const auto state = mw.saveToolBarState();
+    tb.show();
+    tb.removeAction(&a2);
+
+    // hidden toolbars get their actions back right away, but the widgets for them are only created
+    // when they're shown
+    const auto buttonCount = tb.findChildren<QToolButton *>().size();
+    QVERIFY(mw.restoreToolBarState(state));
+    QVERIFY(tb.isHidden());
+    QCOMPARE(tb.actions(), QList<QAction *>({ &a1, &a2 }));
+    QCOMPARE(tb.findChildren<QToolButton *>().size(), buttonCount);
+
+    // saving again gives back the restored state
+    QCOMPARE(mw.saveToolBarState(), state);
+
+    // actions added after the restore are kept
+    QAction a3;
+    a3.setObjectName("test-action-3");
+    tb.addAction(&a3);
+    QCOMPARE(tb.actions(), QList<QAction *>({ &a1, &a2, &a3 }));
+
+    tb.show();
+    QCOMPARE(tb.actions(), QList<QAction *>({ &a1, &a2, &a3 }));
+    QCOMPARE(tb.findChildren<QToolButton *>().size(), buttonCount + 2);
+    const auto buttons = tb.findChildren<QToolButton *>();
+    for (auto *action : { &a1, &a2, &a3 }) {
+        QVERIFY(std::any_of(buttons.begin(), buttons.end(), [action](const QToolButton *button) {
+            return button->defaultAction() == action;
+        }));
+    }
+}
+
+void TestMainWindow::testStateSnapshot()
+{
+    MainWindow mw;
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+    mw.addToolBar(ToolBarTray::Bottom, &tb);
+
+    const auto state = mw.saveToolBarState();
+    mw.addToolBar(ToolBarTray::Right, &tb);
+
+    // decode on another thread, apply on this one
+    auto future = std::async(std::launch::async, [state] {
+        return ToolBarStateSnapshot::fromByteArray(state);
+    });
+    const auto snapshot = future.get();
+    QVERIFY(snapshot.isValid());
+    QVERIFY(mw.restoreToolBarState(snapshot));
+    QCOMPARE(mw.toolBarTray(&tb), ToolBarTray::Bottom);
+
+    // invalid data gives an invalid snapshot
+    const auto invalid = ToolBarStateSnapshot::fromByteArray(state.left(state.size() / 2));
+    QVERIFY(!invalid.isValid());
+    QVERIFY(!mw.restoreToolBarState(invalid));
+}
+
+void TestMainWindow::testPerspectives()
+{
+    MainWindow mw;
+
+    ToolBar tb1;
+    tb1.setObjectName("test-toolbar-1");
+    ToolBar tb2;
+    tb2.setObjectName("test-toolbar-2");
+    mw.addToolBar(&tb1);
+    mw.addToolBar(&tb2);
+
+    mw.captureToolBarPerspective("editing");
+
+    mw.addToolBar(ToolBarTray::Left, &tb1);
+    mw.addToolBar(ToolBarTray::Bottom, &tb2);
+    mw.captureToolBarPerspective("review");
+    QCOMPARE(mw.toolBarPerspectives(), QStringList({ "editing", "review" }));
+
+    QVERIFY(mw.activateToolBarPerspective("editing"));
+    QCOMPARE(mw.toolBarTray(&tb1), ToolBarTray::Top);
+    QCOMPARE(mw.toolBarTray(&tb2), ToolBarTray::Top);
+
+    QVERIFY(mw.activateToolBarPerspective("review"));
+    QCOMPARE(mw.toolBarTray(&tb1), ToolBarTray::Left);
+    QCOMPARE(mw.toolBarTray(&tb2), ToolBarTray::Bottom);
+
+    // activating the current perspective again changes nothing
+    QVERIFY(mw.activateToolBarPerspective("review"));
+    QCOMPARE(mw.lastRestoreChangeCount(), 0);
+
+    // perspectives can be persisted and registered again
+    const auto data = mw.toolBarPerspective("editing").toByteArray();
+    mw.removeToolBarPerspective("editing");
+    QVERIFY(!mw.activateToolBarPerspective("editing"));
+    mw.registerToolBarPerspective("editing", ToolBarStateSnapshot::fromByteArray(data));
+    QVERIFY(mw.activateToolBarPerspective("editing"));
+    QCOMPARE(mw.toolBarTray(&tb1), ToolBarTray::Top);
+}
+
+void TestMainWindow::testAutoSave()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto fileName = dir.filePath("toolbars.state");
+
+    MainWindow mw;
+    mw.setToolBarAutoSaveDelay(10);
+    mw.setToolBarAutoSaveFileName(fileName);
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+    mw.addToolBar(ToolBarTray::Bottom, &tb);
+
+    const auto readState = [&fileName] {
+        QFile file(fileName);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    };
+
+    // written in the background once the changes settle
+    QTRY_COMPARE(readState(), mw.saveToolBarState());
+
+    // pending changes are written when flushing
+    mw.setToolBarAutoSaveDelay(60 * 1000);
+    mw.addToolBar(ToolBarTray::Right, &tb);
+    mw.flushToolBarAutoSave();
+    QCOMPARE(readState(), mw.saveToolBarState());
+
+    MainWindow mw2;
+    ToolBar tb2;
+    tb2.setObjectName("test-toolbar");
+    mw2.addToolBar(&tb2);
+    QVERIFY(mw2.restoreToolBarState(readState()));
+    QCOMPARE(mw2.toolBarTray(&tb2), ToolBarTray::Right);
+}
+
+void TestMainWindow::testAutoSaveFloatingMove()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto fileName = dir.filePath("toolbars.state");
+
+    MainWindow mw;
+    mw.setGeometry(0, 0, 400, 300);
+    mw.setToolBarAutoSaveDelay(60 * 1000);
+    mw.setToolBarAutoSaveFileName(fileName);
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+    tb.addAction(new QAction("Action", &tb));
+    mw.addToolBar(&tb);
+    mw.placeToolBars({ { &tb, ToolBarTray::Top, 0, 0, true, QRect(800, 600, 0, 0) } });
+    QVERIFY(tb.isFloating());
+
+    const auto readState = [&fileName] {
+        QFile file(fileName);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    };
+    mw.flushToolBarAutoSave();
+    const auto floatingState = readState();
+    QCOMPARE(floatingState, mw.saveToolBarState());
+
+    // drag the toolbar by its title, moving a floating toolbar doesn't invalidate the layout
+    const QPoint pressPos(tb.width() / 2, tb.contentsRect().top() + tb.fontMetrics().height());
+    const auto globalPressPos = tb.mapToGlobal(pressPos);
+    const auto sendMouseEvent = [&tb, pressPos](QEvent::Type type, QPoint globalPos, Qt::MouseButtons buttons) {
+        QMouseEvent event(type, pressPos, globalPos, Qt::LeftButton, buttons, Qt::NoModifier);
+        QApplication::sendEvent(&tb, &event);
+    };
+    const auto startPos = tb.pos();
+    sendMouseEvent(QEvent::MouseButtonPress, globalPressPos, Qt::LeftButton);
+    sendMouseEvent(QEvent::MouseMove, globalPressPos + QPoint(50, 40), Qt::LeftButton);
+    sendMouseEvent(QEvent::MouseButtonRelease, globalPressPos + QPoint(50, 40), Qt::NoButton);
+    QVERIFY(tb.isFloating());
+    QCOMPARE(tb.pos(), startPos + QPoint(50, 40));
+
+    mw.flushToolBarAutoSave();
+    QVERIFY(readState() != floatingState);
+    QCOMPARE(readState(), mw.saveToolBarState());
+}
+
+void TestMainWindow::testRestoreDestroyedAction()
+{
+    MainWindow mw;
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+    mw.addToolBar(&tb);
+
+    QAction a1;
+    a1.setObjectName("test-action-1");
+    auto *a2 = new QAction;
+    a2->setObjectName("test-action-2");
+    tb.addAction(&a1);
+    tb.addAction(a2);
+
+    const auto state = mw.saveToolBarState();
+
+    // actions removed from the toolbar are still known, destroyed ones are forgotten
+    tb.removeAction(&a1);
+    delete a2;
+    QCOMPARE(tb.actions(), QList<QAction *>());
+
+    QVERIFY(mw.restoreToolBarState(state));
+    QCOMPARE(tb.actions(), QList<QAction *>({ &a1 }));
+}
+
+void TestMainWindow::testRestoreFloatingLayout()
+{
+    const auto setup = [](MainWindow &mw, ToolBar &tb) {
+        tb.setObjectName("test-toolbar");
+        for (int i = 0; i < 8; ++i) {
+            auto *action = new QAction(QStringLiteral("Action %1").arg(i), &tb);
+            action->setObjectName(QStringLiteral("test-action-%1").arg(i));
+            tb.addAction(action);
+        }
+        mw.addToolBar(&tb);
+    };
+
+    MainWindow mw1;
+    ToolBar tb1;
+    setup(mw1, tb1);
+
+    // float the toolbar narrow enough to wrap its buttons
+    mw1.placeToolBars({ { &tb1, ToolBarTray::Top, 0, 0, true, QRect(50, 50, 1, 0) } });
+    QVERIFY(tb1.isFloating());
+    const auto state = mw1.saveToolBarState();
+
+    // same items, the saved layout is reused without searching for the candidate layouts
+    MainWindow mw2;
+    ToolBar tb2;
+    setup(mw2, tb2);
+    mw2.resetToolBarPerformanceCounters();
+    QVERIFY(mw2.restoreToolBarState(state));
+    QVERIFY(tb2.isFloating());
+    QCOMPARE(tb2.size(), tb1.size());
+    QCOMPARE(mw2.toolBarPerformanceCounters().dynamicLayoutSearches.count, quint64(0));
+
+    // buttons have a different size, the layouts are computed again
+    MainWindow mw3;
+    ToolBar tb3;
+    tb3.setIconSize(QSize(64, 64));
+    setup(mw3, tb3);
+    QVERIFY(mw3.restoreToolBarState(state));
+    QVERIFY(tb3.isFloating());
+    QVERIFY(tb3.size() != tb1.size());
+}
+
+void TestMainWindow::testResetToolBars()
+{
+    MainWindow mw;
+
+    QAction a1;
+    a1.setObjectName("test-action-1");
+    QAction a2;
+    a2.setObjectName("test-action-2");
+
+    ToolBar tb1;
+    tb1.setObjectName("test-toolbar-1");
+    tb1.addAction(&a1);
+    tb1.addAction(&a2);
+    mw.addToolBar(ToolBarTray::Top, &tb1);
+
+    ToolBar tb2;
+    tb2.setObjectName("test-toolbar-2");
+    mw.addToolBar(ToolBarTray::Left, &tb2);
+
+    // nothing to reset to yet
+    QVERIFY(!tb1.canBeReset());
+
+    mw.captureDefaultToolBarState();
+    QVERIFY(mw.defaultToolBarState().isValid());
+    QVERIFY(tb1.canBeReset());
+    QVERIFY(tb2.canBeReset());
+
+    tb1.removeAction(&a1);
+    mw.addToolBar(ToolBarTray::Bottom, &tb2);
+    auto *custom = new ToolBar(ToolBarOption::IsCustom);
+    custom->setWindowTitle("Custom");
+    mw.addToolBar(ToolBarTray::Right, custom);
+    QVERIFY(!custom->canBeReset());
+
+    // resetting one toolbar leaves the other ones alone
+    tb1.reset();
+    QCOMPARE(tb1.actions(), QList<QAction *>({ &a1, &a2 }));
+    QCOMPARE(mw.toolBarTray(&tb2), ToolBarTray::Bottom);
+
+    // resetting all toolbars keeps the custom ones
+    mw.resetToolBars();
+    QCOMPARE(mw.toolBarTray(&tb2), ToolBarTray::Left);
+    QCOMPARE(mw.toolBarCount(), 3);
+    QCOMPARE(mw.toolBarTray(custom), ToolBarTray::Right);
+
+    mw.resetToolBars();
+    QCOMPARE(mw.lastRestoreChangeCount(), 0);
+
+    // subclasses are reset the same way whether they're reset on their own or with all toolbars
+    struct CountingToolBar : ToolBar
+    {
+        void reset() override
+        {
+            ++resetCount;
+            ToolBar::reset();
+        }
+        int resetCount = 0;
+    };
+    CountingToolBar tb3;
+    tb3.setObjectName("test-toolbar-3");
+    mw.addToolBar(ToolBarTray::Top, &tb3);
+    mw.captureDefaultToolBarState();
+    mw.addToolBar(ToolBarTray::Bottom, &tb3);
+    mw.resetToolBars();
+    QCOMPARE(tb3.resetCount, 1);
+    QCOMPARE(mw.toolBarTray(&tb3), ToolBarTray::Top);
+}
+
+void TestMainWindow::testResetToolBarRow()
+{
+    MainWindow mw;
+
+    ToolBar tb1;
+    tb1.setObjectName("test-toolbar-1");
+    ToolBar tb2;
+    tb2.setObjectName("test-toolbar-2");
+    ToolBar tb3;
+    tb3.setObjectName("test-toolbar-3");
+    mw.placeToolBars({ { &tb1, ToolBarTray::Top, 0, 0 }, { &tb2, ToolBarTray::Top, 1, 0 }, { &tb3, ToolBarTray::Top, 1, 100 } });
+    mw.captureDefaultToolBarState();
+    const auto defaultState = mw.saveToolBarState();
+
+    // the first row goes away, resetting doesn't put the toolbar in the row that takes its index
+    mw.addToolBar(ToolBarTray::Left, &tb1);
+    tb1.reset();
+    QCOMPARE(mw.saveToolBarState(), defaultState);
+
+    // the toolbar goes back to the row of the toolbars it was with, wherever that row is now
+    mw.addToolBar(ToolBarTray::Left, &tb3);
+    mw.addToolBar(ToolBarTray::Left, &tb1);
+    tb3.reset();
+    tb1.reset();
+    QCOMPARE(mw.saveToolBarState(), defaultState);
+}
+
+void TestMainWindow::testUndoStack()
+{
+    MainWindow mw;
+    auto *undoStack = mw.toolBarUndoStack();
+    QVERIFY(undoStack != nullptr);
+
+    QAction a1;
+    a1.setObjectName("test-action-1");
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+    mw.addToolBar(&tb);
+    const auto state = mw.saveToolBarState();
+
+    // only customizations made by the user are undoable, not changes made by the application
+    tb.addAction(&a1);
+    QVERIFY(mw.restoreToolBarState(state));
+    mw.resetToolBars();
+    QCOMPARE(undoStack->count(), 0);
+    QVERIFY(!undoStack->canUndo());
+}
+
+void TestMainWindow::testUndoDeleteToolBar()
+{
+    MainWindow mw;
+
+    ToolBar tb;
+    tb.setObjectName("test-toolbar");
+
+    // custom toolbars can have the same title, the one deleted is hidden and alone in its row
+    QPointer<ToolBar> custom1 = new ToolBar(ToolBarOption::IsCustom);
+    custom1->setWindowTitle("Custom");
+    QPointer<ToolBar> custom2 = new ToolBar(ToolBarOption::IsCustom);
+    custom2->setWindowTitle("Custom");
+    mw.placeToolBars({ { &tb, ToolBarTray::Top, 0, 0 }, { custom1, ToolBarTray::Top, 0, 200 }, { custom2, ToolBarTray::Top, 1, 0 } });
+    custom2->hide();
+    const auto state = mw.saveToolBarState();
+
+    // delete the second one from the customization dialog
+    mw.customizeToolBars();
+    auto *dialog = mw.findChild<QDialog *>();
+    QVERIFY(dialog != nullptr);
+    auto *list = dialog->findChild<QAbstractItemView *>();
+    QVERIFY(list != nullptr);
+    const auto *model = list->model();
+    for (int row = 0; row < model->rowCount(); ++row) {
+        const auto index = model->index(row, 0);
+        if (index.data(Qt::UserRole + 1).value<ToolBar *>() == custom2)
+            list->setCurrentIndex(index);
+    }
+    const auto buttons = dialog->findChildren<QPushButton *>();
+    auto deleteButton = std::find_if(buttons.begin(), buttons.end(), [](const QPushButton *button) {
+        return button->text() == "Delete";
+    });
+    QVERIFY(deleteButton != buttons.end());
+    QTimer::singleShot(0, [] {
+        if (auto *box = qobject_cast<QMessageBox *>(QApplication::activeModalWidget()))
+            box->button(QMessageBox::Yes)->click();
+    });
+    (*deleteButton)->click();
+    QVERIFY(custom1);
+    QVERIFY(!custom2);
+    QCOMPARE(mw.toolBarCount(), 2);
+
+    // it comes back in a row of its own, still hidden
+    auto *undoStack = mw.toolBarUndoStack();
+    undoStack->undo();
+    QCOMPARE(mw.toolBarCount(), 3);
+    QCOMPARE(mw.saveToolBarState(), state);
+
+    // the toolbar created again is the one deleted again, not the other one with the same title
+    undoStack->redo();
+    QVERIFY(custom1);
+    QCOMPARE(mw.toolBarCount(), 2);
+
+    // restoring a state drops the undo steps, undoing doesn't bring back what was replaced
+    QVERIFY(undoStack->canUndo());
+    QVERIFY(mw.restoreToolBarState(state));
+    QCOMPARE(mw.toolBarCount(), 3);
+    QVERIFY(!undoStack->canUndo());
+    undoStack->undo();
+    QCOMPARE(mw.toolBarCount(), 3);
+    QCOMPARE(mw.saveToolBarState(), state);
+}
+
+void TestMainWindow::testPlaceToolBars()
+{
+    MainWindow mw;
+
+    ToolBar tb1;
+    ToolBar tb2;
+    ToolBar tb3;
+
+    mw.addToolBar(ToolBarTray::Left, &tb1);
+    QCOMPARE(mw.toolBarCount(), 1);
+
+    // place one existing and two new toolbars
+    mw.placeToolBars({ { &tb1, ToolBarTray::Top, 0, 0 },
+                       { &tb2, ToolBarTray::Top, 0, 200 },
+                       { &tb3, ToolBarTray::Bottom, 1, 0, true, QRect(50, 50, 0, 0) } });
+    QCOMPARE(mw.toolBarCount(), 3);
+    QCOMPARE(mw.toolBarTray(&tb1), ToolBarTray::Top);
+    QCOMPARE(mw.toolBarTray(&tb2), ToolBarTray::Top);
+    QCOMPARE(mw.toolBarTray(&tb3), ToolBarTray::Bottom);
+    QVERIFY(!tb1.isFloating());
+    QVERIFY(!tb2.isFloating());
+    QVERIFY(tb3.isFloating());
+    QCOMPARE(tb3.pos(), QPoint(50, 50));
+
+    mw.resize(800, 600);
+    mw.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&mw));
+
+    // first two toolbars should share the same row
+    QCOMPARE(tb2.y(), tb1.y());
+    QCOMPARE(tb2.x(), tb1.x() + 200);
+
+    // dock the floating toolbar back
+    mw.placeToolBars({ { &tb3, ToolBarTray::Top, 1, 0 } });
+    QVERIFY(!tb3.isFloating());
+    QCOMPARE(mw.toolBarTray(&tb3), ToolBarTray::Top);
+
+    // toolbars with an invalid placement are neither added nor follow the window's icon size
+    ToolBar tb4;
+    const auto iconSize = tb4.iconSize();
+    mw.placeToolBars({ { &tb4, ToolBarTray::None, 0, 0 } });
+    QCOMPARE(mw.toolBarCount(), 3);
+    QCOMPARE(mw.toolBarTray(&tb4), ToolBarTray::None);
+    mw.setIconSize(iconSize * 2);
+    QCOMPARE(tb4.iconSize(), iconSize);
+    QCOMPARE(tb1.iconSize(), mw.iconSize());
+}
+
+void TestMainWindow::testRowPacking()
+{
+    MainWindow mw;
+    mw.setToolBarRowPackingEnabled(true);
+
+    ToolBar tb1;
+    ToolBar tb2;
+    for (int i = 0; i < 10; ++i) {
+        tb1.addAction(new QAction(&tb1));
+        tb2.addAction(new QAction(&tb2));
+    }
+    mw.addToolBar(&tb1);
+    mw.addToolBar(&tb2);
+
+    mw.resize(1000, 400);
+    mw.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&mw));
+
+    // both toolbars fit in the same row
+    QCOMPARE(tb2.y(), tb1.y());
+    const auto pos = tb2.pos();
+
+    // second toolbar should wrap to a new line when the window is too narrow
+    mw.resize(tb1.width() + tb2.width() - 20, 400);
+    QTRY_VERIFY(tb2.y() > tb1.y());
+    QCOMPARE(tb2.x(), tb1.x());
+
+    // and go back to its original position when there's enough room again
+    mw.resize(1000, 400);
+    QTRY_COMPARE(tb2.pos(), pos);
+}
+
+void TestMainWindow::testLockedLayout()
+{
+    MainWindow mw;
+
+    ToolBar tb;
+    tb.addAction(new QAction(&tb));
+    mw.addToolBar(&tb);
+
+    const auto unlockedSize = tb.sizeHint();
+    QVERIFY(tb.testAttribute(Qt::WA_Hover));
+    QVERIFY(tb.acceptDrops());
+
+    // locking the layout hides the handle, so the toolbar gets smaller
+    mw.setToolBarLayoutLocked(true);
+    QVERIFY(mw.isToolBarLayoutLocked());
+    QVERIFY(tb.sizeHint().width() < unlockedSize.width());
+    QVERIFY(!tb.testAttribute(Qt::WA_Hover));
+    QVERIFY(!tb.acceptDrops());
+
+    // toolbars added while locked are locked too
+    ToolBar tb2;
+    mw.addToolBar(&tb2);
+    QVERIFY(!tb2.acceptDrops());
+
+    // unlocking restores everything
+    mw.setToolBarLayoutLocked(false);
+    QCOMPARE(tb.sizeHint(), unlockedSize);
+    QVERIFY(tb.testAttribute(Qt::WA_Hover));
+    QVERIFY(tb.acceptDrops());
+    QVERIFY(tb2.acceptDrops());
+}
+
+void TestMainWindow::testResizeLayoutCache()
+{
+    MainWindow mw;
+    mw.setToolBarRowPackingEnabled(true);
+
+    ToolBar tb1;
+    ToolBar tb2;
+    for (int i = 0; i < 10; ++i) {
+        tb1.addAction(new QAction(&tb1));
+        tb2.addAction(new QAction(&tb2));
+    }
+    mw.addToolBar(&tb1);
+    mw.addToolBar(&tb2);
+
+    mw.resize(1000, 400);
+    mw.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&mw));
+
+    const auto wideGeometry = tb2.geometry();
+    mw.resize(tb1.width() + tb2.width() - 20, 400);
+    QTRY_VERIFY(tb2.y() > tb1.y());
+    const auto narrowGeometry = tb2.geometry();
+
+    // going back and forth over the same sizes gives the same layouts, without laying out the
+    // trays again
+    mw.resetToolBarPerformanceCounters();
+    for (int i = 0; i < 3; ++i) {
+        mw.resize(1000, 400);
+        QTRY_COMPARE(tb2.geometry(), wideGeometry);
+        mw.resize(tb1.width() + tb2.width() - 20, 400);
+        QTRY_COMPARE(tb2.geometry(), narrowGeometry);
+    }
+    QVERIFY(mw.toolBarPerformanceCounters().layoutPasses.count > 0);
+    QCOMPARE(mw.toolBarPerformanceCounters().trayLayouts.count, quint64(0));
+
+    // structural changes aren't hidden by previous layouts
+    ToolBar tb3;
+    tb3.addAction(new QAction(&tb3));
+    mw.addToolBar(ToolBarTray::Left, &tb3);
+    mw.resize(1000, 400);
+    QTRY_VERIFY(tb3.y() > tb1.geometry().bottom());
+    QCOMPARE(tb2.geometry(), wideGeometry);
+    QVERIFY(mw.toolBarPerformanceCounters().trayLayouts.count > 0);
+}
+
+void TestMainWindow::testPerformanceCounters()
+{
+    MainWindow mw;
+
+    ToolBar tb1;
+    ToolBar tb2;
+    for (int i = 0; i < 10; ++i) {
+        tb1.addAction(new QAction(&tb1));
+        tb2.addAction(new QAction(&tb2));
+    }
+    mw.addToolBar(&tb1);
+    mw.addToolBar(&tb2);
+    mw.resize(1000, 400);
+    mw.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&mw));
+
+    auto counters = mw.toolBarPerformanceCounters();
+    QVERIFY(counters.toolBarLayoutUpdates.count > 0);
+    QVERIFY(counters.trayRowSizeUpdates.count > 0);
+    QVERIFY(counters.trayLayouts.count > 0);
+    // every button and both toolbars
+    QVERIFY(counters.widgetGeometryUpdates.count >= 22);
+    QCOMPARE(counters.dockTransitions.count, quint64(0));
+
+    mw.resetToolBarPerformanceCounters();
+    counters = mw.toolBarPerformanceCounters();
+    QCOMPARE(counters.trayLayouts.count, quint64(0));
+    QCOMPARE(counters.trayLayouts.nsecs, qint64(0));
+
+    mw.placeToolBars({ { &tb2, ToolBarTray::Top, 0, 0, true, QRect(QPoint(100, 100), QSize()) } });
+    QTRY_VERIFY(mw.toolBarPerformanceCounters().dynamicLayoutSearches.count > 0);
+    counters = mw.toolBarPerformanceCounters();
+    QCOMPARE(counters.dockTransitions.count, quint64(1));
+    QVERIFY(counters.trayLayouts.count > 0);
+}
+
+void TestMainWindow::testTrace()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto fileName = dir.filePath("trace.json");
+
+    MainWindow mw;
+    QVERIFY(!mw.isToolBarTraceActive());
+    QTest::ignoreMessage(QtWarningMsg, "MainWindow::stopToolBarTrace: Not tracing");
+    QVERIFY(!mw.stopToolBarTrace(fileName));
+
+    ToolBar tb1;
+    tb1.setObjectName("test-toolbar-1");
+    tb1.addAction(new QAction(&tb1));
+    mw.addToolBar(&tb1);
+    mw.resize(1000, 400);
+    const auto state = mw.saveToolBarState();
+
+    mw.startToolBarTrace();
+    QVERIFY(mw.isToolBarTraceActive());
+    mw.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&mw));
+    mw.placeToolBars({ { &tb1, ToolBarTray::Top, 0, 0, true, QRect(QPoint(100, 100), QSize()) } });
+    QTRY_VERIFY(tb1.isVisible());
+    QVERIFY(mw.restoreToolBarState(state));
+    QVERIFY(mw.stopToolBarTrace(fileName));
+    QVERIFY(!mw.isToolBarTraceActive());
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const auto trace = QJsonDocument::fromJson(file.readAll()).object();
+    const auto events = trace.value("traceEvents").toArray();
+    QVERIFY(!events.isEmpty());
+
+    QSet<QString> names;
+    for (const auto &value : events) {
+        const auto event = value.toObject();
+        QCOMPARE(event.value("ph").toString(), QString("X"));
+        QVERIFY(event.value("dur").toDouble() >= 0);
+        names.insert(event.value("name").toString());
+        if (event.value("name").toString() == "undock")
+            QCOMPARE(event.value("args").toObject().value("toolbar").toString(), QString("test-toolbar-1"));
+    }
+    QVERIFY(names.contains("layout"));
+    QVERIFY(names.contains("undock"));
+    QVERIFY(names.contains("dock"));
+    QVERIFY(names.contains("restoreState"));
+    QVERIFY(names.contains("applyState"));
+}
+
+void TestMainWindow::testTraceHooks()
+{
+    struct Scopes
+    {
+        int begun = 0;
+        int ended = 0;
+        int depth = 0;
+        int maxDepth = 0;
+    } scopes;
+    TraceHooks hooks;
+    hooks.beginScope = [](const char *, void *userData) {
+        auto *scopes = static_cast<Scopes *>(userData);
+        ++scopes->begun;
+        scopes->maxDepth = std::max(scopes->maxDepth, ++scopes->depth);
+    };
+    hooks.endScope = [](const char *, void *userData) {
+        auto *scopes = static_cast<Scopes *>(userData);
+        ++scopes->ended;
+        --scopes->depth;
+    };
+    hooks.userData = &scopes;
+    setTraceHooks(hooks);
+
+    {
+        MainWindow mw;
+        ToolBar tb1;
+        tb1.addAction(new QAction(&tb1));
+        mw.addToolBar(&tb1);
+        mw.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&mw));
+    }
+    setTraceHooks({});
+
+    // scopes are only reported if the library was built with them
+    if (hasTraceHooksSupport()) {
+        QVERIFY(scopes.begun > 0);
+        QVERIFY(scopes.maxDepth > 1);
+    } else {
+        QCOMPARE(scopes.begun, 0);
+    }
+    QCOMPARE(scopes.ended, scopes.begun);
+    QCOMPARE(scopes.depth, 0);
+}
+
+void TestMainWindow::testDebugOverlay()
+{
+    MainWindow mw;
+    ToolBar tb1;
+    tb1.addAction(new QAction(&tb1));
+    mw.addToolBar(&tb1);
+    mw.resize(1000, 400);
+    mw.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&mw));
+    const auto state = mw.saveToolBarState();
+
+    QVERIFY(!mw.isToolBarDebugOverlayVisible());
+    mw.setToolBarDebugOverlayVisible(true);
+    QVERIFY(mw.isToolBarDebugOverlayVisible());
+    auto *overlay = mw.findChild<QWidget *>("kdtoolbars-debug-overlay");
+    QVERIFY(overlay != nullptr);
+    QVERIFY(overlay->isVisible());
+    QVERIFY(!overlay->size().isEmpty());
+    QVERIFY(overlay->parentWidget()->rect().contains(overlay->geometry()));
+
+    // the overlay isn't a toolbar and isn't saved
+    QCOMPARE(mw.toolBarCount(), 1);
+    QCOMPARE(mw.saveToolBarState(), state);
+
+    mw.setToolBarDebugOverlayVisible(false);
+    QVERIFY(!mw.isToolBarDebugOverlayVisible());
+    QVERIFY(mw.findChild<QWidget *>("kdtoolbars-debug-overlay") == nullptr);
+}
+
+void TestMainWindow::testMemoryUsage()
+{
+    ReceiverCountingMainWindow mw;
+    ReceiverCountingToolBar tb1;
+    ReceiverCountingToolBar tb2;
+    QPixmap pixmap(16, 16);
+    pixmap.fill(Qt::red);
+    const QIcon icon(pixmap);
+    auto *action = new ReceiverCountingAction(icon, QString(), &tb1);
+    tb1.addAction(action);
+    for (int i = 1; i < 10; ++i) {
+        tb1.addAction(new QAction(icon, QString(), &tb1));
+        tb2.addAction(new QAction(&tb2));
+    }
+    tb2.addAction(new QAction(&tb2));
+    mw.addToolBar(&tb1);
+    mw.addToolBar(&tb2);
+
+    // every button, the close button and the drop indicator
+    const auto usage1 = tb1.memoryUsage();
+    const auto usage2 = tb2.memoryUsage();
+    QCOMPARE(usage1.childWidgetCount, 12);
+    // the buttons follow the icon size and style of the toolbar, which also has a close button
+    QCOMPARE(usage1.connectionCount, tb1.receiverCount() + 1);
+    QCOMPARE(usage2.connectionCount, tb2.receiverCount() + 1);
+    // the icon shared by all the buttons is only counted once, both toolbars have a close button
+    const auto iconExtent = static_cast<qint64>(std::ceil(16 * tb1.devicePixelRatioF()));
+    QCOMPARE(usage1.pixmapBytes - usage2.pixmapBytes, iconExtent * iconExtent * 4);
+    QCOMPARE(usage1.dynamicLayoutCount, 0);
+    QCOMPARE(usage1.stateBytes, qint64(0));
+
+    // the window adds its own connections and those of every toolbar and registered action
+    auto usage = mw.toolBarMemoryUsage();
+    QCOMPARE(usage.childWidgetCount, 24);
+    QVERIFY(usage.connectionCount > usage1.connectionCount + usage2.connectionCount + mw.receiverCount());
+    QCOMPARE(usage.pixmapBytes, usage1.pixmapBytes + usage2.pixmapBytes);
+    QCOMPARE(usage.stateBytes, qint64(0));
+
+    // broken connections aren't counted
+    const auto actionReceivers = action->receiverCount();
+    QVERIFY(actionReceivers > 0);
+    const auto toolbarReceivers = tb1.receiverCount();
+    delete action;
+    QCOMPARE(tb1.memoryUsage().connectionCount, usage1.connectionCount - (toolbarReceivers - tb1.receiverCount()));
+    QCOMPARE(mw.toolBarMemoryUsage().connectionCount,
+             usage.connectionCount - (toolbarReceivers - tb1.receiverCount()) - actionReceivers);
+    usage = mw.toolBarMemoryUsage();
+    const auto windowReceivers = mw.receiverCount();
+    mw.removeToolBar(&tb2);
+    QCOMPARE(mw.toolBarMemoryUsage().connectionCount,
+             usage.connectionCount - usage2.connectionCount - (windowReceivers - mw.receiverCount()));
+    mw.addToolBar(&tb2);
+    tb2.show();
+
+    // perspectives sharing the default state don't hold more memory
+    mw.captureDefaultToolBarState();
+    usage = mw.toolBarMemoryUsage();
+    QVERIFY(usage.stateBytes > 0);
+    mw.registerToolBarPerspective("default", mw.defaultToolBarState());
+    QCOMPARE(mw.toolBarMemoryUsage().stateBytes, usage.stateBytes);
+
+    mw.resize(1000, 400);
+    mw.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&mw));
+    mw.placeToolBars({ { &tb2, ToolBarTray::Top, 0, 0, true, QRect(QPoint(100, 100), QSize()) } });
+    QTRY_VERIFY(tb2.memoryUsage().dynamicLayoutCount > 0);
+    QVERIFY(tb2.memoryUsage().dynamicLayoutBytes > 0);
+    QCOMPARE(mw.toolBarMemoryUsage().dynamicLayoutCount, tb2.memoryUsage().dynamicLayoutCount);
+}
+
 QTEST_MAIN(TestMainWindow)
 #include "tst_mainwindow.moc"